@@ -77,6 +77,12 @@ public:
 
     static void halt() { ASM("wfi"); }
 
+    static void pause() { ASM("yield"); }
+    static void wait_event() { ASM("wfe"); }
+    static void signal_event() { ASM("dsb sy \n sev" : : : "memory"); }
+
+    static void memory_barrier() { ASM("dmb sy" : : : "memory"); }
+
     template<typename T>
     static T tsl(volatile T & lock) {
         register T old;
@@ -649,6 +655,10 @@ public:
     using Base::int_disabled;
 
     using Base::halt;
+    using Base::pause;
+    using Base::wait_event;
+    using Base::signal_event;
+    using Base::memory_barrier;
 
     using Base::fpu_save;
     using Base::fpu_restore;
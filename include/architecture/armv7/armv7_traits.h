@@ -12,6 +12,7 @@ template<> struct Traits<CPU>: public Traits<Build>
     static const unsigned int WORD_SIZE         = 32;
     static const unsigned int CLOCK             = (MODEL == LM3S811) ? 50000000 : (MODEL == Zynq) ? 666666687 : (MODEL == Realview_PBX) ? 100000000 : 1400000000L;
     static const bool unaligned_memory_access   = false;
+    static const unsigned int CACHE_LINE_SIZE   = ((MODEL == LM3S811) || (MODEL == eMote3)) ? 4 : 32;   // Cortex-M3 has no caches
 };
 
 template<> struct Traits<MMU>: public Traits<Build>
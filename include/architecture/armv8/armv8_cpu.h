@@ -544,6 +544,10 @@ public:
     using Base::int_disabled;
 
     using Base::halt;
+    using Base::pause;
+    using Base::wait_event;
+    using Base::signal_event;
+    using Base::memory_barrier;
 
     using Base::fpu_save;
     using Base::fpu_restore;
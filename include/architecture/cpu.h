@@ -103,6 +103,12 @@ public:
 
     static void halt() { for(;;); }
 
+    static void pause() {}                          // spin-wait hint
+    static void wait_event() { pause(); }           // spin-wait until some core calls signal_event() (or an interrupt)
+    static void signal_event() {}
+
+    static void memory_barrier() { ASM("" : : : "memory"); } // full fence (compiler-only by default)
+
     static void switch_context(Context * volatile * o, Context * volatile n);
 
 
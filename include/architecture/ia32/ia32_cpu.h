@@ -95,7 +95,8 @@ public:
 
     // CR4 Flags
     enum {
-        CR4_PSE     = 1 << 8    // CR4 Performance Counter Enable
+        CR4_PSE     = 1 << 4,   // Page Size Extensions (4 MB pages)
+        CR4_PCE     = 1 << 8    // Performance-Monitoring Counter Enable
     };
 
     // Segment Flags
@@ -377,6 +378,12 @@ public:
 
     static void halt() { ASM("hlt"); }
 
+    static void pause() { ASM("pause"); }
+    static void wait_event() { pause(); }
+    static void signal_event() {}
+
+    static void memory_barrier() { ASM("mfence" : : : "memory"); }
+
     static void fpu_save() {} // TODO
     static void fpu_restore() {} // TODO
 
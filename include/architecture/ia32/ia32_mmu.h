@@ -14,11 +14,11 @@ class MMU: public MMU_Common<10, 10, 12>
     friend class Setup;
 
 private:
-    typedef Grouping_List<Frame> List;
     typedef MMU_Common<10, 10, 12> Common;
 
     static const bool colorful = Traits<MMU>::colorful;
-    static const unsigned int COLORS = Traits<MMU>::COLORS;
+    static const bool superpages = Traits<MMU>::superpages;
+    static const unsigned int COLORS = colorful ? page_colors(Traits<Machine>::LLC_SIZE, Traits<Machine>::LLC_WAYS) : 1;
     static const unsigned int RAM_BASE  = Memory_Map::RAM_BASE;
     static const unsigned int APP_LOW   = Memory_Map::APP_LOW;
     static const unsigned int APP_HIGH  = Memory_Map::APP_HIGH;
@@ -26,6 +26,8 @@ private:
     static const unsigned int SYS       = Memory_Map::SYS;
     static const unsigned int SYS_HIGH  = Memory_Map::SYS_HIGH;
 
+    typedef Buddy_Allocator<sizeof(Frame), Memory_Map::RAM_BASE, Memory_Map::RAM_TOP, COLORS> Buddy;
+
 public:
     // Page Flags
     class Page_Flags
@@ -84,7 +86,7 @@ public:
         Page_Table & log() { return *static_cast<Page_Table *>(phy2log(this)); }
 
         void map(int from, int to, Page_Flags flags, Color color) {
-            Phy_Addr * addr = alloc(to - from, color);
+            Phy_Addr * addr = (!colorful || (color == WHITE)) ? alloc(to - from, color) : Phy_Addr(false); // colored frames are never contiguous
             if(addr)
                 remap(addr, from, to, flags);
             else
@@ -95,7 +97,7 @@ public:
         }
 
         void map_contiguous(int from, int to, Page_Flags flags, Color color) {
-            remap(alloc(to - from, color), from, to, flags);
+            remap(alloc(to - from, WHITE), from, to, flags);
         }
 
         void remap(Phy_Addr addr, int from, int to, Page_Flags flags) {
@@ -146,26 +148,34 @@ public:
     class Chunk
     {
     public:
-        Chunk(const Chunk & c): _free(false), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt) {} // avoid freeing memory when temporaries are created
+        Chunk(const Chunk & c): _free(false), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt), _color(c._color) {} // avoid freeing memory when temporaries are created
 
         Chunk(unsigned long bytes, Flags flags, Color color = WHITE)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
+        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(color) {
             if(_flags & Page_Flags::CT)
                 _pt->map_contiguous(_from, _to, _flags, color);
             else
                 _pt->map(_from, _to, _flags, color);
         }
 
+        // Clone of c (page faults are not recoverable on IA32, so it is copied right away instead of copy-on-write)
+        Chunk(const Chunk & c, Flags flags)
+        : _free(true), _from(c._from), _to(c._to), _pts(c._pts), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(c._color) {
+            _pt->map(_from, _to, _flags, _color);
+            for(unsigned int i = _from; i < _to; i++)
+                memcpy(phy2log(pte2phy(_pt->log()[i])), phy2log(pte2phy(c._pt->log()[i])), sizeof(Page));
+        }
+
         Chunk(Phy_Addr phy_addr, unsigned long bytes, Flags flags)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
+        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(WHITE) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {}
+        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt), _color(WHITE) {}
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags, Phy_Addr phy_addr)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {
+        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt), _color(WHITE) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
@@ -196,27 +206,41 @@ public:
             return (_flags & Page_Flags::CT) ? Phy_Addr(unflag((*_pt)[_from])) : Phy_Addr(false);
         }
 
-        unsigned long resize(long amount) {
+        // Pages added take frames of "color" (WHITE keeps the chunk's own)
+        unsigned long resize(long amount, Color color = WHITE) {
             if(_flags & Page_Flags::CT)
                 return 0;
 
-            unsigned long pgs = pages(amount);
-
-            Color color = colorful ? phy2color(_pt) : WHITE;
+            if(amount > 0) {
+                unsigned long pgs = pages(amount);
+
+                unsigned long free_pgs = _pts * PT_ENTRIES - _to;
+                if(free_pgs < pgs) { // resize _pt
+                    unsigned long pts = _pts + Common::pts(pgs - free_pgs);
+                    Page_Table * pt = calloc(pts, WHITE);
+                    memcpy(phy2log(pt), phy2log(_pt), _pts * sizeof(Page));
+                    free(_pt, _pts);
+                    _pt = pt;
+                    _pts = pts;
+                }
 
-            unsigned long free_pgs = _pts * PT_ENTRIES - _to;
-            if(free_pgs < pgs) { // resize _pt
-                unsigned long pts = _pts + Common::pts(pgs - free_pgs);
-                Page_Table * pt = calloc(pts, color);
-                memcpy(phy2log(pt), phy2log(_pt), _pts * sizeof(Page));
-                free(_pt, _pts);
-                _pt = pt;
-                _pts = pts;
+                _pt->map(_to, _to + pgs, _flags, (color == WHITE) ? _color : color);
+                _to += pgs;
+            } else if((amount < 0) && !(_flags & Page_Flags::IO)) { // only whole pages are released
+                unsigned long pgs = -amount / sizeof(Page);
+                if(pgs > _to - _from)
+                    pgs = _to - _from;
+                _pt->unmap(_to - pgs, _to);
+                _to -= pgs;
+                flush_tlb();
+
+                unsigned int pts = _to ? Common::pts(_to) : 1; // page tables left empty are released too (but the first one)
+                if(_free && (pts < _pts)) {
+                    free(Phy_Addr(_pt) + pts * sizeof(Page), _pts - pts);
+                    _pts = pts;
+                }
             }
 
-            _pt->map(_to, _to + pgs, _flags, color);
-            _to += pgs;
-
             return size();
         }
 
@@ -227,6 +251,7 @@ public:
         unsigned int _pts;
         Page_Flags _flags;
         Page_Table * _pt; // this is a physical address
+        Color _color;
     };
 
     // Directory (for Address_Space)
@@ -266,8 +291,9 @@ public:
         }
 
         void detach(const Chunk & chunk) {
+            Phy_Addr sp = superpage(chunk.pt());
             for(unsigned int i = 0; i < PD_ENTRIES; i++) {
-                if(unflag(pte2phy((*_pd)[i])) == unflag(chunk.pt())) {
+                if(maps((*_pd)[i], chunk.pt(), sp)) {
                     detach(i, chunk.pt(), chunk.pts());
                     return;
                 }
@@ -277,30 +303,55 @@ public:
 
         void detach(const Chunk & chunk, Log_Addr addr) {
             unsigned int from = pdi(addr);
-            if(unflag(pte2phy((*_pd)[from])) != unflag(chunk.pt())) {
+            if(!maps((*_pd)[from], chunk.pt(), superpage(chunk.pt()))) {
                 db<MMU>(WRN) << "MMU::Directory::detach(pt=" << chunk.pt() << ",addr=" << addr << ") failed!" << endl;
                 return;
             }
             detach(from, chunk.pt(), chunk.pts());
         }
 
-        Phy_Addr physical(Log_Addr addr) {
-            PD_Entry pde = (*_pd)[pdi(addr)];
-            Page_Table * pt = static_cast<Page_Table *>(pde2phy(pde));
-            PT_Entry pte = pt->log()[pti(addr)];
-            return pte | off(addr);
+        // Resizes a chunk attached at addr and updates the attachment, since resizing might change the chunk's
+        // page tables (growing moves them) and superpages (shrinking breaks them up)
+        unsigned long resize(Chunk & chunk, Log_Addr addr, long amount) {
+            unsigned int from = pdi(addr);
+            unsigned int pts = chunk.pts();
+            unsigned long size = chunk.size();
+            if((chunk.resize(amount) > size) && (chunk.pts() > pts) && !attachable(from + pts, chunk.pts() - pts)) {
+                db<MMU>(WRN) << "MMU::Directory::resize(chunk=" << &chunk << ",addr=" << addr << ",amount=" << amount << "): growing the chunk would overlap other attachments!" << endl;
+                chunk.resize(long(size) - long(chunk.size()));
+            }
+            for(unsigned int i = chunk.pts(); i < pts; i++) // page tables released by the chunk
+                _pd->log()[from + i] = 0;
+            map(from, chunk.pt(), chunk.pts(), chunk.flags());
+            flush_tlb();
+            return chunk.size();
         }
 
+        Phy_Addr physical(Log_Addr addr) { return walk(_pd, addr); }
+
     private:
-        bool attach(unsigned int from, const Page_Table * pt, unsigned int n, Page_Flags flags) {
+        bool attachable(unsigned int from, unsigned int n) {
             for(unsigned int i = from; i < from + n; i++)
                 if(_pd->log()[i])
                     return false;
-            for(unsigned int i = from; i < from + n; i++, pt++)
-                _pd->log()[i] = phy2pde(Phy_Addr(pt), flags);
             return true;
         }
 
+        bool attach(unsigned int from, const Page_Table * pt, unsigned int n, Page_Flags flags) {
+            if(!attachable(from, n))
+                return false;
+            map(from, pt, n, flags);
+            return true;
+        }
+
+        void map(unsigned int from, const Page_Table * pt, unsigned int n, Page_Flags flags) {
+            for(unsigned int i = from; i < from + n; i++, pt++) {
+                Phy_Addr sp = superpage(Phy_Addr(pt));
+                Page_Table * t = Phy_Addr(pt);
+                _pd->log()[i] = sp ? phy2pde(sp, pte2flg(t->log()[0]) | Page_Flags::PS) : phy2pde(Phy_Addr(pt), flags);
+            }
+        }
+
         void detach(unsigned int from, const Page_Table * pt, unsigned int n) {
             for(unsigned int i = from; i < from + n; i++) {
                 _pd->log()[i] = 0;
@@ -308,6 +359,11 @@ public:
             }
         }
 
+        // Whether a directory entry maps the page table pt, either by pointing to it or as its superpage sp
+        static bool maps(PD_Entry pde, Phy_Addr pt, Phy_Addr sp) {
+            return leaf(pde) ? (sp && (unflag(pde2phy(pde)) == sp)) : (unflag(pde2phy(pde)) == unflag(pt));
+        }
+
     private:
         bool _free;
         Page_Directory * _pd;  // this is a physical address, but operator*() returns a logical address
@@ -374,15 +430,11 @@ public:
         Phy_Addr phy(false);
 
         if(frames) {
-            List::Element * e = _free[color].search_decrementing(frames);
-            if(e) {
-                phy = e->object() + e->size();
+            phy = _free.alloc(frames, colorful ? color : WHITE);
+            if(phy)
                 db<MMU>(TRC) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => " << phy << endl;
-            } else
-                if(colorful)
-                    db<MMU>(INF) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
-                else
-                    db<MMU>(WRN) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
+            else
+                db<MMU>(WRN) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
         }
 
         return phy;
@@ -397,38 +449,69 @@ public:
     static void free(Phy_Addr frame, unsigned long n = 1) {
         // Clean up MMU flags in frame address
         frame = unflag(frame);
-        Color color = colorful ? phy2color(frame) : WHITE;
 
-        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << color << ",n=" << n << ")" << endl;
+        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",n=" << n << ")" << endl;
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[color].insert_merging(e, &m1, &m2);
-        }
+        if(frame && n)
+            _free.free(frame, n);
     }
 
-    static void white_free(Phy_Addr frame, unsigned long n) {
-        // Clean up MMU flags in frame address
-        frame = unflag(frame);
-
-        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << WHITE << ",n=" << n << ")" << endl;
+    static void white_free(Phy_Addr frame, unsigned long n) { free(frame, n); }
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[WHITE].insert_merging(e, &m1, &m2);
-        }
-    }
+    static unsigned long allocable(Color color = WHITE) { return _free.largest(); }
 
-    static unsigned long allocable(Color color = WHITE) { return _free[color].head() ? _free[color].head()->size() : 0; }
+    static unsigned int colors() { return COLORS; }
 
     static Page_Directory * volatile current() { return static_cast<Page_Directory * volatile>(pd()); }
 
-    static Phy_Addr physical(Log_Addr addr) {
+    static Phy_Addr physical(Log_Addr addr) { return walk(current(), addr); }
+
+    // Marks the page that contains addr in the current directory as not present (on) or present again (off), so accesses
+    // to it fault (e.g. a guard page under a stack); pages in 4 MB pages can't be guarded
+    static bool guard(Log_Addr addr, bool on) {
         Page_Directory * pd = current();
-        Page_Table * pt = pd->log()[pdi(addr)];
-        return pt->log()[pti(addr)] | off(addr);
+        PD_Entry pde = pd->log()[pdi(addr)];
+        if(!(pde & Page_Flags::PRE) || leaf(pde))
+            return false;
+        Page_Table * pt = pde2phy(pde);
+        PT_Entry & pte = pt->log()[pti(addr)];
+
+        if(on) {
+            if(!(pte & Page_Flags::PRE))
+                return false;
+            pte &= ~Page_Flags::PRE;
+        } else {
+            if((pte & Page_Flags::PRE) || !pte2phy(pte))
+                return false;
+            pte |= Page_Flags::PRE;
+        }
+        flush_tlb(addr);
+
+        db<MMU>(TRC) << "MMU::guard(addr=" << addr << ",on=" << on << ")" << endl;
+
+        return true;
+    }
+
+    // Physical address of the 4 MB page (PSE) that can replace a page table, i.e. if its entries map consecutive
+    // frames with the same flags starting at a 4 MB boundary, or 0 otherwise
+    // Directories copy the PDE when the chunk is attached, so Chunk::reflag() only affects later attachments
+    static Phy_Addr superpage(Phy_Addr pt) {
+        if(!superpages)
+            return Phy_Addr(false);
+
+        Page_Table * t = pt;
+        PT_Entry first = t->log()[0];
+        Phy_Addr base = pte2phy(first);
+        if(!(first & Page_Flags::PRE) || (base & (sizeof(Big_Page) - 1)))
+            return Phy_Addr(false);
+
+        for(unsigned int i = 1; i < PT_ENTRIES; i++) {
+            PT_Entry pte = t->log()[i];
+            if((pte2phy(pte) != base + i * sizeof(Page)) || ((pte2flg(pte) | Page_Flags::ACC | Page_Flags::DRT) != (pte2flg(first) | Page_Flags::ACC | Page_Flags::DRT)))
+                return Phy_Addr(false);
+        }
+
+        return base;
     }
 
     static PT_Entry phy2pte(Phy_Addr frame, Page_Flags flags) { return frame | flags; }
@@ -436,6 +519,9 @@ public:
     static Page_Flags pte2flg(PT_Entry entry) { return (entry & Page_Flags::MASK); }
     static PD_Entry phy2pde(Phy_Addr frame, Page_Flags flags) { return frame | flags; }
     static Phy_Addr pde2phy(PD_Entry entry) { return (entry & ~Page_Flags::MASK); }
+
+    // Present PDEs with PS set map 4 MB pages, the others point to page tables
+    static bool leaf(PD_Entry entry) { return (entry & Page_Flags::PRE) && (entry & Page_Flags::PS); }
     static Page_Flags pde2flg(PT_Entry entry) { return (entry & Page_Flags::MASK); }
 
 #ifdef __setup__
@@ -447,19 +533,26 @@ public:
     static Phy_Addr log2phy(Log_Addr log) { return Phy_Addr((RAM_BASE == PHY_MEM) ? log : (RAM_BASE > PHY_MEM) ? log + (RAM_BASE - PHY_MEM) : log - (PHY_MEM - RAM_BASE)); }
 #endif
 
-    static Color phy2color(Phy_Addr phy) { return static_cast<Color>(colorful ? ((phy >> PT_SHIFT) & 0x7f) % COLORS : WHITE); } // TODO: what is 0x7f
+    static Color phy2color(Phy_Addr phy) { return static_cast<Color>(colorful ? (phy >> PT_SHIFT) % COLORS : WHITE); }
 
     static Color log2color(Log_Addr log) {
         if(colorful) {
-            Page_Directory * pd = current();
-            Page_Table * pt = pd->log()[pdi(log)];
-            Phy_Addr phy = pt->log()[pti(log)] | off(log);
-            return static_cast<Color>(((phy >> PT_SHIFT) & 0x7f) % COLORS);
+            Phy_Addr phy = walk(current(), log);
+            return static_cast<Color>((phy >> PT_SHIFT) % COLORS);
         } else
             return WHITE;
     }
 
 private:
+    // Translates addr through pd, stopping at 4 MB pages
+    static Phy_Addr walk(Page_Directory * pd, Log_Addr addr) {
+        PD_Entry pde = pd->log()[pdi(addr)];
+        if(leaf(pde))
+            return pde2phy(pde) | (addr & (sizeof(Big_Page) - 1));
+        Page_Table * pt = pde2phy(pde);
+        return pte2phy(pt->log()[pti(addr)]) | off(addr);
+    }
+
     static Phy_Addr pd() { return CPU::pd(); }
     static void pd(Phy_Addr pd) { CPU::pd(pd); }
 
@@ -469,7 +562,7 @@ private:
     static void init();
 
 private:
-    static List _free[colorful * COLORS + 1]; // +1 for WHITE
+    static Buddy _free;
     static Page_Directory * _master;
 };
 
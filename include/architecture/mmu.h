@@ -70,6 +70,7 @@ public:
             IO   = 1 << 11, // Memory Mapped I/O (0=memory, 1=I/O)
             CT   = 1 << 12, // Contiguous (0=non-contiguous, 1=contiguous)
             SPE  = 1 << 13,
+            LZ   = 1 << 14, // Lazy (0=backed at creation, 1=each page backed by a zeroed frame when first touched)
             SYSC = (PRE | RD | EX),
             SYSD = (PRE | RD | WR),
             APPC = (PRE | RD | EX | USR),
@@ -126,6 +127,435 @@ public:
     constexpr static Log_Addr align_segment(Log_Addr addr) { return (addr + PT_ENTRIES * sizeof(Page) - 1) &  ~(PT_ENTRIES * sizeof(Page) - 1); }
 
     constexpr static Log_Addr directory_bits(Log_Addr addr) { return (addr & ~((1 << PD_BITS) - 1)); }
+
+    // Number of page colors of a cache (pages of different colors never compete for the same cache sets),
+    // rounded down to a power of two and limited to the colors in Color
+    constexpr static unsigned int page_colors(unsigned long size, unsigned int ways) {
+        return (size / ways <= PG_SIZE) ? 1 : (size / ways / PG_SIZE >= WHITE) ? WHITE : 1U << LOG2(size / ways / PG_SIZE);
+    }
+};
+
+
+// Binary buddy allocator for the physical frames in [BASE, TOP]
+// Free blocks of 2^k frames (k is the block's order) are linked in per-order lists and marked in per-order bitmaps,
+// so telling whether a block's buddy is free is O(1) and both alloc() and free() are O(log n) on the number of frames.
+// Requests that are not a power of two take the smallest block that fits and give its tail back. Single frames go
+// through small per-CPU caches first. The links live in a table indexed by frame (8 bytes per frame), so free frames
+// are never touched (memory that is still in use while given away, such as INIT on IA32, survives). That table and
+// the bitmaps are too large for the kernel's data segment, so MMU::init() carves them from the memory being managed
+// and hands them to init() before giving the allocator any frames.
+// With COLORS > 1, frames of a given color (physical frame number modulo COLORS) come from per-color lists, refilled
+// by splitting a block of COLORS frames (one of each color); freed frames go back to the buddy lists.
+// A zero-initialized allocator is empty and unlocked, so it can be used (once init()) before global constructors run.
+template<unsigned long FRAME, unsigned long BASE, unsigned long TOP, unsigned int COLORS = 1>
+class Buddy_Allocator
+{
+private:
+    typedef CPU::Phy_Addr Phy_Addr;
+
+    static const unsigned long FRAMES = (TOP - BASE) / FRAME + 1;
+    static const unsigned int ORDERS = LOG2(FRAMES) + 1;
+    static const unsigned int BITS = sizeof(unsigned long) * 8;
+    static const unsigned long WORDS = (2 * FRAMES + ORDERS) / BITS + 1;
+    static const unsigned int CPUS = Traits<Build>::CPUS;
+    static const unsigned int CACHE = Traits<MMU>::FRAME_CACHE;
+    static const unsigned int BATCH = (CACHE + 1) / 2;
+    static const unsigned long NONE = ~0UL;
+
+    // Links of a free block (frame numbers + 1, so 0 ends a list)
+    struct Link
+    {
+        unsigned int next;
+        unsigned int prev;
+    };
+
+    struct Cache
+    {
+        unsigned int count;
+        unsigned long frames[CACHE ? CACHE : 1];
+    };
+
+public:
+    // Bytes taken by the tables given to init()
+    static const unsigned long TABLES = FRAMES * sizeof(Link) + WORDS * sizeof(unsigned long);
+
+public:
+    // Sets (and clears) the tables, at the logical address "tables"
+    void init(void * tables) {
+        memset(tables, 0, TABLES);
+        _links = reinterpret_cast<Link *>(tables);
+        _map = reinterpret_cast<unsigned long *>(_links + FRAMES);
+    }
+
+    // Returns the first of n contiguous frames (or 0 if there is no such block)
+    // Contiguous frames cannot share a color, so colored requests must be for a single frame
+    Phy_Addr alloc(unsigned long n, Color color = WHITE) {
+        unsigned long f = NONE;
+
+        if((COLORS > 1) && (color != WHITE)) {
+            if(n == 1) {
+                bool enabled = lock();
+                f = take_colored(color % COLORS);
+                unlock(enabled);
+            }
+        } else if(CACHE && (n == 1))
+            f = cached_alloc();
+        else if(n) {
+            bool enabled = lock();
+            f = take(n);
+            unlock(enabled);
+        }
+
+        return (f == NONE) ? Phy_Addr(false) : phy(f);
+    }
+
+    void free(Phy_Addr frame, unsigned long n) {
+        if(!n)
+            return;
+
+        unsigned long addr = frame;
+        unsigned long f = (addr - BASE) / FRAME;
+        if((addr < BASE) || (f + n > FRAMES)) {
+            db<MMU>(WRN) << "MMU::free(frame=" << frame << ",n=" << n << "): frames outside of the allocator's range!" << endl;
+            return;
+        }
+
+        if(CACHE && (n == 1))
+            cached_free(f);
+        else {
+            bool enabled = lock();
+            give(f, n);
+            unlock(enabled);
+        }
+    }
+
+    // Number of frames in the largest free block (i.e., the largest request alloc() can currently serve)
+    unsigned long largest() const {
+        for(unsigned int k = ORDERS; k > 0; k--)
+            if(_heads[k - 1])
+                return 1UL << (k - 1);
+        return 0;
+    }
+
+    // Number of free frames (not counting those in per-CPU caches)
+    unsigned long frames() const { return _frames + _colored_frames; }
+
+    // Allocated frames have no use for their links, so those shared copy-on-write count their extra owners there
+    void share(Phy_Addr frame) {
+        bool enabled = lock();
+        _links[(frame - BASE) / FRAME].next++;
+        unlock(enabled);
+    }
+
+    // Drops an owner of a shared frame; returns false if the frame was not shared (i.e. the caller is its last owner)
+    bool unshare(Phy_Addr frame) {
+        bool enabled = lock();
+        Link * l = &_links[(frame - BASE) / FRAME];
+        bool shared = l->next;
+        if(shared)
+            l->next--;
+        unlock(enabled);
+        return shared;
+    }
+
+    // Resolves a write to a shared frame mapped by *entry, provided *entry still holds "expected" (i.e., no other CPU
+    // resolved it first): the last owner sets it to "last", any other drops its ownership and sets it to "copy" (a
+    // private copy it has already made), unless there is no copy (0); returns the entry as left
+    template<typename Entry>
+    Entry unshare(Phy_Addr frame, volatile Entry * entry, Entry expected, Entry last, Entry copy) {
+        bool enabled = lock();
+        Entry e = *entry;
+        if(e == expected) {
+            Link * l = &_links[(frame - BASE) / FRAME];
+            if(!l->next)
+                e = last;
+            else if(copy) {
+                l->next--;
+                e = copy;
+            }
+            *entry = e;
+        }
+        unlock(enabled);
+        return e;
+    }
+
+    bool shared(Phy_Addr frame) const { return _links[(frame - BASE) / FRAME].next; }
+
+private:
+    static Phy_Addr phy(unsigned long f) { return BASE + f * FRAME; }
+    static unsigned int color(unsigned long f) { return (BASE / FRAME + f) % COLORS; }
+
+    // Order of the smallest block with at least n frames
+    static unsigned int order(unsigned long n) { return LOG2(n) + ((n & (n - 1)) ? 1 : 0); }
+
+    // First bit of order k in _map
+    static unsigned long offset(unsigned int k) {
+        unsigned long o = 0;
+        for(unsigned int i = 0; i < k; i++)
+            o += (FRAMES >> i) + 1;
+        return o;
+    }
+
+    bool test(unsigned int k, unsigned long f) const { unsigned long b = offset(k) + (f >> k); return _map[b / BITS] & (1UL << (b % BITS)); }
+    void set(unsigned int k, unsigned long f) { unsigned long b = offset(k) + (f >> k); _map[b / BITS] |= (1UL << (b % BITS)); }
+    void clear(unsigned int k, unsigned long f) { unsigned long b = offset(k) + (f >> k); _map[b / BITS] &= ~(1UL << (b % BITS)); }
+
+    void insert(unsigned long f, unsigned int k) {
+        Link * l = &_links[f];
+        l->next = _heads[k];
+        l->prev = 0;
+        if(_heads[k])
+            _links[_heads[k] - 1].prev = f + 1;
+        _heads[k] = f + 1;
+        set(k, f);
+        _frames += 1UL << k;
+    }
+
+    void remove(unsigned long f, unsigned int k) {
+        Link * l = &_links[f];
+        if(l->prev)
+            _links[l->prev - 1].next = l->next;
+        else
+            _heads[k] = l->next;
+        if(l->next)
+            _links[l->next - 1].prev = l->prev;
+        l->next = l->prev = 0; // see share()
+        clear(k, f);
+        _frames -= 1UL << k;
+    }
+
+    // Takes a block of order k, splitting a larger one if needed
+    unsigned long take_block(unsigned int k) {
+        unsigned int j = k;
+        while((j < ORDERS) && !_heads[j])
+            j++;
+        if(j >= ORDERS) {
+            if(!_colored_frames)
+                return NONE;
+            uncolor();
+            return take_block(k);
+        }
+
+        unsigned long f = _heads[j] - 1;
+        remove(f, j);
+        while(j > k) {
+            j--;
+            insert(f + (1UL << j), j);
+        }
+
+        return f;
+    }
+
+    // Gives a block of order k back, merging it with its free buddies
+    void give_block(unsigned long f, unsigned int k) {
+        for(; k < ORDERS - 1; k++) {
+            unsigned long b = f ^ (1UL << k);
+            if((b + (1UL << k) > FRAMES) || !test(k, b))
+                break;
+            remove(b, k);
+            f &= ~(1UL << k);
+        }
+        insert(f, k);
+    }
+
+    unsigned long take(unsigned long n) {
+        unsigned int k = order(n);
+        if(k >= ORDERS)
+            return NONE;
+
+        unsigned long f = take_block(k);
+        if((f != NONE) && ((1UL << k) > n))
+            give(f + n, (1UL << k) - n);
+
+        return f;
+    }
+
+    // Gives n frames back as the largest aligned blocks that fit
+    void give(unsigned long f, unsigned long n) {
+        while(n) {
+            unsigned int k = f ? __builtin_ctzl(f) : ORDERS - 1;
+            if(k > LOG2(n))
+                k = LOG2(n);
+            if(k > ORDERS - 1)
+                k = ORDERS - 1;
+            give_block(f, k);
+            f += 1UL << k;
+            n -= 1UL << k;
+        }
+    }
+
+    // Takes a frame of color c, splitting a block with one frame of each color into the per-color lists if needed
+    unsigned long take_colored(unsigned int c) {
+        if(!_colored[c]) {
+            unsigned long b = take_block(LOG2(COLORS));
+            if(b == NONE)
+                return NONE;
+            for(unsigned long f = b; f < b + COLORS; f++) {
+                unsigned int i = color(f);
+                _links[f].next = _colored[i];
+                _colored[i] = f + 1;
+            }
+            _colored_frames += COLORS;
+        }
+
+        unsigned long f = _colored[c] - 1;
+        _colored[c] = _links[f].next;
+        _links[f].next = 0;
+        _colored_frames--;
+
+        return f;
+    }
+
+    // Gives all frames in the per-color lists back to the buddy lists
+    void uncolor() {
+        for(unsigned int c = 0; c < COLORS; c++)
+            while(_colored[c]) {
+                unsigned long f = _colored[c] - 1;
+                _colored[c] = _links[f].next;
+                give_block(f, 0);
+            }
+        _colored_frames = 0;
+    }
+
+    // Per-CPU caches are only touched by their own CPU with interrupts disabled
+    unsigned long cached_alloc() {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+
+        Cache * c = &_cache[CPU::id()];
+        if(!c->count) {
+            lock();
+            for(unsigned int i = 0; i < BATCH; i++) {
+                unsigned long f = take_block(0);
+                if(f == NONE)
+                    break;
+                c->frames[c->count++] = f;
+            }
+            unlock(false);
+        }
+        unsigned long f = c->count ? c->frames[--c->count] : NONE;
+
+        if(enabled)
+            CPU::int_enable();
+
+        return f;
+    }
+
+    void cached_free(unsigned long f) {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+
+        Cache * c = &_cache[CPU::id()];
+        if(c->count == CACHE) {
+            lock();
+            for(unsigned int i = 0; i < BATCH; i++)
+                give_block(c->frames[--c->count], 0);
+            unlock(false);
+        }
+        c->frames[c->count++] = f;
+
+        if(enabled)
+            CPU::int_enable();
+    }
+
+    bool lock() {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+        while(CPU::tsl(_locked))
+            while(_locked)
+                CPU::pause();
+        return enabled;
+    }
+
+    void unlock(bool enabled) {
+        CPU::memory_barrier(); // publish the updates before the lock (a plain store)
+        _locked = false;
+        if(enabled)
+            CPU::int_enable();
+    }
+
+private:
+    volatile bool _locked;
+    unsigned int _heads[ORDERS];
+    unsigned long * _map;               // WORDS bits, from init()
+    Link * _links;                      // FRAMES links, from init()
+    unsigned long _frames;
+    unsigned int _colored[COLORS];
+    unsigned long _colored_frames;
+    Cache _cache[CACHE ? CPUS : 1];
+};
+
+// Address-space identifiers (ASIDs) for TLB tagging, handed out in generations
+// Each directory keeps a tag with the generation and the ASID it was last given. Once ASIDs run out, a new generation
+// starts, invalidating all tags of older ones, and each CPU flushes its whole TLB once before switching to a directory
+// of the new generation. ASID 0 is never handed out (it is left for the boot-time memory map).
+// A zero-initialized allocator knows of no ASIDs (see size()), so it can be used before global constructors run.
+template<unsigned int BITS>
+class ASID_Allocator
+{
+private:
+    static const unsigned int CPUS = Traits<Build>::CPUS;
+    static const unsigned long MASK = (1UL << BITS) - 1;
+    static const unsigned long GENERATION = 1UL << BITS;
+
+public:
+    typedef unsigned long Tag; // generation << BITS | ASID (0 = none yet)
+
+public:
+    // Number of ASIDs (as implemented by the hardware, which might be none)
+    unsigned int size() const { return _size; }
+    void size(unsigned int n) { _size = (n > MASK) ? MASK + 1 : n; }
+
+    // Returns the ASID of the tag, renewing it if it is from an older generation, and whether the calling CPU
+    // must flush its TLB before using it
+    unsigned int asid(volatile Tag * tag, bool * flush) {
+        if(_size < 2) {
+            *flush = true;
+            return 0;
+        }
+
+        bool enabled = lock();
+        if(!_generation)
+            _generation = GENERATION;
+        if((*tag & ~MASK) != _generation) {
+            if(_next == 0 || _next >= _size) {
+                if(_next)
+                    _generation += GENERATION;
+                _next = 1;
+            }
+            *tag = _generation | _next++;
+        }
+        unsigned int cpu = CPU::id();
+        *flush = (_flushed[cpu] != _generation);
+        _flushed[cpu] = _generation;
+        unlock(enabled);
+
+        return *tag & MASK;
+    }
+
+private:
+    bool lock() {
+        bool enabled = CPU::int_enabled();
+        CPU::int_disable();
+        while(CPU::tsl(_locked))
+            while(_locked)
+                CPU::pause();
+        return enabled;
+    }
+
+    void unlock(bool enabled) {
+        CPU::memory_barrier(); // publish the updates before the lock (a plain store)
+        _locked = false;
+        if(enabled)
+            CPU::int_enable();
+    }
+
+private:
+    volatile bool _locked;
+    unsigned int _size;
+    unsigned int _next;
+    Tag _generation;
+    Tag _flushed[CPUS];
 };
 
 class No_MMU: public MMU_Common<0, 0, 0>
@@ -155,6 +585,7 @@ public:
         Chunk() {}
         Chunk(const Chunk & c): _free(false), _phy_addr(c._phy_addr), _bytes(c._bytes), _flags(c._flags) {} // avoid freeing memory when temporaries are created
         Chunk(unsigned long bytes, Flags flags, Color color = WHITE): _free(true), _phy_addr(alloc(bytes)), _bytes(bytes), _flags(flags) {}
+        Chunk(const Chunk & c, Flags flags): _free(true), _phy_addr(alloc(c._bytes)), _bytes(c._bytes), _flags(flags) { memcpy(_phy_addr, c._phy_addr, _bytes); } // clones are copied right away
         Chunk(Phy_Addr phy_addr, unsigned long bytes, Flags flags):  _free(false), _phy_addr(phy_addr), _bytes(bytes), _flags(flags) {}
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags):_free(false), _phy_addr(0), _bytes(to - from), _flags(flags) {}
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags, Phy_Addr phy_addr): _free(false), _phy_addr(phy_addr), _bytes(to - from), _flags(flags) {}
@@ -167,7 +598,7 @@ public:
         unsigned long size() const { return _bytes; }
         void reflag(Flags flags) { _flags = flags; }
         Phy_Addr phy_address() const { return _phy_addr; } // always CT
-        long resize(unsigned long amount) { return 0; } // no resize in CT
+        long resize(unsigned long amount, Color color = WHITE) { return 0; } // no resize in CT
 
     private:
         bool _free;
@@ -194,6 +625,7 @@ public:
         Log_Addr attach(const Chunk & chunk, Log_Addr addr) { return (addr == chunk.phy_address())? addr : Log_Addr(false); }
         void detach(const Chunk & chunk) {}
         void detach(const Chunk & chunk, Log_Addr addr) {}
+        unsigned long resize(Chunk & chunk, Log_Addr addr, long amount) { return chunk.resize(amount); }
 
         Phy_Addr physical(Log_Addr addr) { return addr; }
     };
@@ -268,6 +700,11 @@ public:
 
     static unsigned long allocable(Color color = WHITE) { return _free.head() ? _free.head()->size() : 0; }
 
+    static unsigned int colors() { return 1; }
+
+    static bool fault(Log_Addr addr, Flags access = Flags::RD) { return false; }
+    static bool guard(Log_Addr addr, bool on) { return false; }
+
     static Page_Directory * volatile current() { return 0; }
 
     static Phy_Addr physical(Log_Addr addr) { return addr; }
@@ -13,12 +13,24 @@ template<> struct Traits<CPU>: public Traits<Build>
     static const unsigned int WORD_SIZE         = 32;
     static const unsigned int CLOCK             = 50000000;
     static const bool unaligned_memory_access   = false;
+    static const unsigned int CACHE_LINE_SIZE   = 64;
 };
 
 template<> struct Traits<MMU>: public Traits<Build>
 {
+    // Cache page coloring (the number of colors comes from the machine's last-level cache geometry)
     static const bool colorful = false;
-    static const unsigned int COLORS = 1;
+
+    // Per-CPU caches of single frames in front of the buddy frame allocator
+    static const unsigned int FRAME_CACHE = 16;
+
+    // Attach page tables that map whole, aligned and contiguous ranges as superpages (4 MB megapages on SV32)
+    // Leaves are copied when attaching, so segments must be reflagged or cloned before being attached
+    static const bool superpages = false;
+
+    // Tag TLB entries with address-space identifiers (as many as the hardware implements), so switching address
+    // spaces does not flush the TLB
+    static const bool asids = true;
 };
 
 template<> struct Traits<FPU>: public Traits<Build>
@@ -243,6 +243,12 @@ public:
 
     static void halt() { ASM("wfi"); }
 
+    static void pause() { ASM(".word 0x0100000f"); } // Zihintpause's PAUSE, a FENCE hint executed as a no-op by older harts
+    static void wait_event() { pause(); }
+    static void signal_event() {}
+
+    static void memory_barrier() { ASM("fence rw, rw" : : : "memory"); }
+
     static void fpu_save();
     static void fpu_restore();
 
@@ -317,6 +323,7 @@ public:
 
     static void flush_tlb() {         ASM("sfence.vma"    : :           : "memory"); }
     static void flush_tlb(Reg addr) { ASM("sfence.vma %0" : : "r"(addr) : "memory"); }
+    static void flush_tlb(Reg addr, Reg asid) { ASM("sfence.vma %0, %1" : : "r"(addr), "r"(asid) : "memory"); }
 
     using CPU_Common::htole64;
     using CPU_Common::htole32;
@@ -460,7 +467,7 @@ public:
 
     static void sret() { ASM("sret"); }
 
-    static void satp(Reg r) { ASM("csrw satp, %0" : : "r"(r) : "cc"); ASM("sfence.vma" : : : "memory"); }
+    static void satp(Reg r) { ASM("csrw satp, %0" : : "r"(r) : "cc"); } // no TLB flush (see MMU::pd())
     static Reg  satp() { Reg r; ASM("csrr %0, satp" :  "=r"(r) : : ); return r; }
 
 private:
@@ -16,16 +16,27 @@ class SV39_MMU: public MMU_Common<9, 9, 12, 9>
     friend class Setup;
 
 private:
-    typedef Grouping_List<Frame> List;
     typedef MMU_Common<9, 9, 12, 9> Common;
 
     static const bool colorful = Traits<MMU>::colorful;
-    static const unsigned long COLORS = Traits<MMU>::COLORS;
+    static const bool superpages = Traits<MMU>::superpages;
+    static const bool asids = Traits<MMU>::asids;
+    static const unsigned int COLORS = colorful ? page_colors(Traits<Machine>::LLC_SIZE, Traits<Machine>::LLC_WAYS) : 1;
     static const unsigned long RAM_BASE = Memory_Map::RAM_BASE;
     static const unsigned long PHY_MEM = Memory_Map::PHY_MEM;
     static const unsigned long APP_LOW = Memory_Map::APP_LOW;
     static const unsigned long APP_HIGH = Memory_Map::APP_HIGH;
 
+    typedef Buddy_Allocator<sizeof(Frame), Memory_Map::RAM_BASE, Memory_Map::RAM_TOP, COLORS> Buddy;
+
+    // satp fields
+    static const Reg MODE = 1UL << 63;
+    static const unsigned int ASID_SHIFT = 44;
+    static const Reg ASID_MASK = (1UL << 16) - 1;
+    static const Reg PPN_MASK = (1UL << 44) - 1;
+
+    typedef ASID_Allocator<16> ASIDs;
+
 public:
     // Page Flags
     class Page_Flags
@@ -42,6 +53,7 @@ public:
             D    = 1 << 7, // Dirty
             CT   = 1 << 8, // Contiguous (reserved for use by supervisor RSW)
             MIO  = 1 << 9, // I/O (reserved for use by supervisor RSW)
+            CW   = CT | MIO, // Copy-on-write (both supervisor RSW bits, a combination chunks never use)
 
             IAD  = (Traits<Build>::MODEL == Traits<Build>::SiFive_U) ? A | D : 0, // SiFive-U RV64 MMU can't handle A and D and requires it to be set
 
@@ -105,7 +117,7 @@ public:
         _Page_Table & log() { return *static_cast<_Page_Table *>(phy2log(this)); }
 
         void map(int from, int to, Page_Flags flags, Color color) {
-            Phy_Addr * addr = alloc(to - from, color);
+            Phy_Addr * addr = (!colorful || (color == WHITE)) ? alloc(to - from, color) : Phy_Addr(false); // colored frames are never contiguous
             if(addr)
                 remap(addr, from, to, flags);
             else
@@ -116,7 +128,15 @@ public:
         }
 
         void map_contiguous(int from, int to, Page_Flags flags, Color color) {
-            remap(alloc(to - from, color), from, to, flags);
+            remap(alloc(to - from, WHITE), from, to, flags);
+        }
+
+        // Leaves the pages unbacked until first touched (see fault())
+        void map_lazy(int from, int to, Page_Flags flags, Color color) {
+            for( ; from < to; from++) {
+                Log_Addr * pte = phy2log(&_entry[from]);
+                *pte = lazy(flags, color);
+            }
         }
 
         void remap(Phy_Addr addr, int from, int to, Page_Flags flags) {
@@ -128,17 +148,41 @@ public:
             }
         }
 
+        // Maps the same frames as pt, write-protecting both while the frames are shared (see fault())
+        void share(_Page_Table * pt, int from, int to, Page_Flags flags) {
+            for( ; from < to; from++) {
+                Log_Addr * src = phy2log(&pt->_entry[from]);
+                Log_Addr * pte = phy2log(&_entry[from]);
+                PT_Entry entry = *src;
+                if(entry & Page_Flags::V) {
+                    _free.share(pte2phy(entry));
+                    if(entry & Page_Flags::W)
+                        *src = cow(entry);
+                    *pte = (flags & Page_Flags::W) ? cow(phy2pte(pte2phy(entry), flags)) : phy2pte(pte2phy(entry), flags);
+                } else if(entry)
+                    *pte = lazy(flags, Color(pte2phy(entry) >> PT_SHIFT));
+            }
+        }
+
         void reflag(int from, int to, Page_Flags flags) {
             for( ; from < to; from++) {
                 Log_Addr * pte = phy2log(&_entry[from]);
-                *pte = phy2pte(pte2phy(_entry[from]), flags);
+                PT_Entry entry = *pte;
+                if(entry & Page_Flags::V) {
+                    Phy_Addr frame = pte2phy(entry);
+                    bool shared = (flags & Page_Flags::W) && !(entry & Page_Flags::W) && _free.shared(frame);
+                    *pte = shared ? cow(phy2pte(frame, flags)) : phy2pte(frame, flags);
+                } else
+                    *pte = lazy(flags, Color(pte2phy(entry) >> PT_SHIFT));
             }
         }
 
         void unmap(int from, int to) {
             for( ; from < to; from++) {
-                free(_entry[from]);
                 Log_Addr * pte = phy2log(&_entry[from]);
+                PT_Entry entry = *pte;
+                if((entry & Page_Flags::V) && ((entry & Page_Flags::W) || !_free.unshare(pte2phy(entry)))) // lazy pages might have never been touched and shared ones (never writable) might still be in use
+                    free(pte2phy(entry));
                 *pte = 0;
             }
         }
@@ -175,26 +219,40 @@ public:
     class Chunk
     {
     public:
-        Chunk(const Chunk & c): _free(false), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt) {} // avoid freeing memory when temporaries are created
+        Chunk(const Chunk & c): _free(false), _from(c._from), _to(c._to), _pts(c._pts), _flags(c._flags), _pt(c._pt), _color(c._color), _lazy(c._lazy) {} // avoid freeing memory when temporaries are created
 
         Chunk(unsigned long bytes, Flags flags, Color color = WHITE)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
+        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(color), _lazy((flags & Flags::LZ) && !(flags & Flags::CT)) {
             if(_flags & Page_Flags::CT)
                 _pt->map_contiguous(_from, _to, _flags, color);
+            else if(_lazy)
+                _pt->map_lazy(_from, _to, _flags, color);
             else
                 _pt->map(_from, _to, _flags, color);
         }
 
+        // Copy-on-write clone of c, whose frames both share until either writes to them (contiguous and I/O chunks can't be cloned)
+        Chunk(const Chunk & c, Flags flags)
+        : _free(true), _from(c._from), _to(c._to), _pts(c._pts), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(c._color), _lazy(c._lazy) {
+            if(c._flags & (Page_Flags::CT | Page_Flags::MIO)) {
+                db<MMU>(WRN) << "MMU::Chunk(c=" << &c << "): contiguous and I/O chunks can't be cloned!" << endl;
+                _to = _from;
+            } else {
+                _pt->share(c._pt, _from, _to, _flags);
+                flush_tlb(); // c might be in use
+            }
+        }
+
         Chunk(Phy_Addr phy_addr, unsigned long bytes, Flags flags)
-        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)) {
+        : _free(true), _from(0), _to(pages(bytes)), _pts(Common::pts(_to - _from)), _flags(Page_Flags(flags)), _pt(calloc(_pts, WHITE)), _color(WHITE), _lazy(false) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {}
+        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt), _color(WHITE), _lazy(false) {}
 
         Chunk(Phy_Addr pt, unsigned int from, unsigned int to, Flags flags, Phy_Addr phy_addr)
-        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt) {
+        : _free(false), _from(from), _to(to), _pts(Common::pts(_to - _from)), _flags(flags), _pt(pt), _color(WHITE), _lazy(false) {
             _pt->remap(phy_addr, _from, _to, flags);
         }
 
@@ -202,10 +260,9 @@ public:
             if(_free) {
                 if(!(_flags & Page_Flags::IO)) {
                     if(_flags & Page_Flags::CT)
-                        free((*_pt)[_from], _to - _from);
+                        free(pte2phy(_pt->log()[_from]), _to - _from);
                     else
-                        for( ; _from < _to; _from++)
-                            free((*_pt)[_from]);
+                        _pt->unmap(_from, _to);
                 }
                 free(_pt, _pts);
             }
@@ -222,32 +279,46 @@ public:
         }
 
         Phy_Addr phy_address() const {
-            return (_flags & Page_Flags::CT) ? Phy_Addr(unflag((*_pt)[_from])) : Phy_Addr(false);
+            return (_flags & Page_Flags::CT) ? pte2phy(_pt->log()[_from]) : Phy_Addr(false);
         }
 
-        unsigned long resize(long amount) {
+        // Pages added take frames of "color" (WHITE keeps the chunk's own)
+        unsigned long resize(long amount, Color color = WHITE) {
             if(_flags & Page_Flags::CT)
                 return 0;
 
             if(amount > 0) {
                 unsigned long pgs = pages(amount);
 
-                Color color = colorful ? phy2color(_pt) : WHITE;
-
                 unsigned long free_pgs = _pts * PT_ENTRIES - _to;
                 if(free_pgs < pgs) { // resize _pt
                     unsigned long pts = _pts + Common::pts(pgs - free_pgs);
-                    Page_Table * pt = calloc(pts, color);
+                    Page_Table * pt = calloc(pts, WHITE);
                     memcpy(phy2log(pt), phy2log(_pt), _pts * sizeof(Page));
                     free(_pt, _pts);
                     _pt = pt;
                     _pts = pts;
                 }
 
-                _pt->map(_to, _to + pgs, _flags, color);
+                if(_lazy)
+                    _pt->map_lazy(_to, _to + pgs, _flags, (color == WHITE) ? _color : color);
+                else
+                    _pt->map(_to, _to + pgs, _flags, (color == WHITE) ? _color : color);
                 _to += pgs;
-            } else
-                db<MMU>(WRN) << "MMU::Chunk::resize(amount=" << amount << "): segment shrinking not implemented!" << endl;
+            } else if((amount < 0) && !(_flags & Page_Flags::MIO)) { // only whole pages are released
+                unsigned long pgs = -amount / sizeof(Page);
+                if(pgs > _to - _from)
+                    pgs = _to - _from;
+                _pt->unmap(_to - pgs, _to);
+                _to -= pgs;
+                flush_tlb();
+
+                unsigned int pts = _to ? Common::pts(_to) : 1; // page tables left empty are released too (but the first one)
+                if(_free && (pts < _pts)) {
+                    free(Phy_Addr(_pt) + pts * sizeof(Page), _pts - pts);
+                    _pts = pts;
+                }
+            }
 
             return size();
         }
@@ -259,21 +330,23 @@ public:
         unsigned int _pts;
         Page_Flags _flags;
         Page_Table * _pt; // this is a physical address
+        Color _color;
+        bool _lazy;
     };
 
     // Directory (for Address_Space, an L2 SV39 page table)
     class Directory
     {
     public:
-        Directory(const Directory & d): _free(false), _pd(d._pd) {} // avoid freeing memory when temporaries are created
+        Directory(const Directory & d): _free(false), _pd(d._pd), _asid(d._asid) {} // avoid freeing memory when temporaries are created
 
-        Directory(): _free(true), _pd(calloc(1, WHITE)) {
+        Directory(): _free(true), _pd(calloc(1, WHITE)), _asid(0) {
             for(unsigned int i = 0; i < PD_ENTRIES; i++)
                 if(!((i >= pdi(APP_LOW)) && (i <= pdi(APP_HIGH))))
                     _pd->log()[i] = _master->log()[i];
         }
 
-        Directory(Page_Directory * pd): _free(false), _pd(pd) {}
+        Directory(Page_Directory * pd): _free(false), _pd(pd), _asid(0) {}
 
         ~Directory() {
             if(_free) {
@@ -288,14 +361,20 @@ public:
 
         Phy_Addr pd() const { return _pd; }
 
-        void activate() const { SV39_MMU::pd(_pd); }
+        // Switches to this address space, flushing the TLB only if ASIDs are not available or ran out (see ASID_Allocator)
+        void activate() {
+            bool flush;
+            unsigned int asid = SV39_MMU::asid(&_asid, &flush);
+            SV39_MMU::pd(_pd, asid, flush);
+        }
 
         Log_Addr find(const Chunk & chunk) {
+            Phy_Addr sp = superpage(chunk.pt());
             for(unsigned int i = 0; i < PD_ENTRIES; i++) {
                 Attacher * at = pde2phy(_pd->log()[i]);
-                if(at)
+                if(at && !leaf(_pd->log()[i]))
                     for(unsigned int j = 0; j < AT_ENTRIES; j++)
-                        if(unflag(ate2phy(at->log()[j])) == unflag(chunk.pt()))
+                        if(maps(at->log()[j], chunk.pt(), sp))
                             return (i << PD_SHIFT) + (j << AT_SHIFT);
             }
             return Log_Addr(false);
@@ -334,11 +413,27 @@ public:
                 db<MMU>(WRN) << "MMU::Directory::detach(chunk=" << &chunk << ",addr=" << addr << ") [pt=" << chunk.pt() << "] failed!" << endl;
         }
 
-        Phy_Addr physical(Log_Addr addr) {
-            Attacher * at = _pd->log()[pdi(addr)];
-            Page_Table * pt = at->log()[ati(addr)];
-            return pt->log()[pti(addr)] | off(addr);
-        };
+        // Resizes a chunk attached at addr and updates the attachment, since resizing might change the chunk's
+        // page tables (growing moves them) and superpages (shrinking breaks them up)
+        unsigned long resize(Chunk & chunk, Log_Addr addr, long amount) {
+            unsigned int pts = chunk.pts();
+            unsigned long size = chunk.size();
+            if((chunk.resize(amount) > size) && (chunk.pts() > pts) && !attachable(addr + pts * sizeof(Big_Page), chunk.pt() + pts, chunk.pts() - pts, chunk.flags())) {
+                db<MMU>(WRN) << "MMU::Directory::resize(chunk=" << &chunk << ",addr=" << addr << ",amount=" << amount << "): growing the chunk would overlap other attachments!" << endl;
+                chunk.resize(long(size) - long(chunk.size()));
+            }
+            for(unsigned int i = chunk.pts(); i < pts; i++) { // page tables released by the chunk
+                Log_Addr a = addr + i * sizeof(Big_Page);
+                Attacher * at = pde2phy(_pd->log()[pdi(a)]);
+                if(at)
+                    at->log()[ati(a)] = 0;
+            }
+            attach(addr, chunk.pt(), chunk.pts(), chunk.flags());
+            flush_tlb();
+            return chunk.size();
+        }
+
+        Phy_Addr physical(Log_Addr addr) { return walk(_pd, addr); }
 
     private:
         bool attachable(Log_Addr addr, const Page_Table * pt, unsigned int pts, Page_Flags flags) {
@@ -361,8 +456,11 @@ public:
                     at = calloc(1, WHITE);
                     _pd->log()[i] = phy2pde(Phy_Addr(at));
                 }
-                for(unsigned int j = ati(addr); j < ati(addr) + pts; j++, pt++)
-                    at->log()[j & (AT_ENTRIES - 1)] = phy2ate(Phy_Addr(pt));
+                for(unsigned int j = ati(addr); j < ati(addr) + pts; j++, pt++) {
+                    Phy_Addr sp = superpage(Phy_Addr(pt));
+                    Page_Table * t = Phy_Addr(pt);
+                    at->log()[j & (AT_ENTRIES - 1)] = sp ? phy2pte(sp, pte2flg(t->log()[0])) : phy2ate(Phy_Addr(pt));
+                }
             }
             return addr;
         }
@@ -372,7 +470,7 @@ public:
                 Attacher * at = pde2phy(_pd->log()[i]);
                 if(at) {
                     for(unsigned int j = ati(addr); j < ati(addr) + pts; j++, pt++)
-                        if(unflag(ate2phy(at->log()[j & (AT_ENTRIES - 1)])) == unflag(pt))
+                        if(maps(at->log()[j & (AT_ENTRIES - 1)], Phy_Addr(pt), superpage(Phy_Addr(pt))))
                             at->log()[j] = 0;
                         else
                             return Log_Addr(false);
@@ -382,9 +480,15 @@ public:
             return addr;
         }
 
+        // Whether an attacher entry maps the page table pt, either by pointing to it or as its superpage sp
+        static bool maps(AT_Entry ate, Phy_Addr pt, Phy_Addr sp) {
+            return leaf(ate) ? (sp && (ate2phy(ate) == sp)) : (unflag(ate2phy(ate)) == unflag(pt));
+        }
+
     private:
         bool _free;
         Page_Directory * _pd;  // this is a physical address, but operator*() returns a logical address
+        ASIDs::Tag _asid;
     };
 
     // DMA_Buffer
@@ -451,15 +555,11 @@ public:
         Phy_Addr phy(false);
 
         if(frames) {
-            List::Element * e = _free[color].search_decrementing(frames);
-            if(e) {
-                phy = e->object() + e->size();
+            phy = _free.alloc(frames, colorful ? color : WHITE);
+            if(phy)
                 db<MMU>(TRC) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => " << phy << endl;
-            } else
-                if(colorful)
-                    db<MMU>(INF) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
-                else
-                    db<MMU>(WRN) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
+            else
+                db<MMU>(WRN) << "MMU::alloc(frames=" << frames << ",color=" << color << ") => failed!" << endl;
         }
 
         return phy;
@@ -474,39 +574,142 @@ public:
     static void free(Phy_Addr frame, unsigned long n = 1) {
         // Clean up MMU flags in frame address
         frame = unflag(frame);
-        Color color = colorful ? phy2color(frame) : WHITE;
 
-        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << color << ",n=" << n << ")" << endl;
+        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",n=" << n << ")" << endl;
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[color].insert_merging(e, &m1, &m2);
-        }
+        if(frame && n)
+            _free.free(frame, n);
     }
 
-    static void white_free(Phy_Addr frame, unsigned long n) {
-        // Clean up MMU flags in frame address
-        frame = unflag(frame);
+    static void white_free(Phy_Addr frame, unsigned long n) { free(frame, n); }
 
-        db<MMU>(TRC) << "MMU::free(frame=" << frame << ",color=" << WHITE << ",n=" << n << ")" << endl;
+    static unsigned long allocable(Color color = WHITE) { return _free.largest(); }
 
-        if(frame && n) {
-            List::Element * e = new (phy2log(frame)) List::Element(frame, n);
-            List::Element * m1, * m2;
-            _free[WHITE].insert_merging(e, &m1, &m2);
-        }
-    }
-
-    static unsigned long allocable(Color color = WHITE) { return _free[color].head() ? _free[color].head()->size() : 0; }
+    static unsigned int colors() { return COLORS; }
 
     static Page_Directory * volatile current() { return static_cast<Page_Directory * volatile>(pd()); }
 
-    static Phy_Addr physical(Log_Addr addr) {
+    static Phy_Addr physical(Log_Addr addr) { return walk(current(), addr); }
+
+    // Backs the lazy page (see Flags::LZ) that contains addr with a zeroed frame or gives a copy-on-write page (see
+    // Chunk's cloning constructor) a private, writable copy of its frame upon a write (access is RD, WR or EX);
+    // pages that already grant the access (e.g. resolved by another CPU first) just get their TLB entry flushed;
+    // returns false if the access is illegal
+    static bool fault(Log_Addr addr, Flags access = Flags::RD) {
+        Page_Directory * pd = current();
+        PD_Entry pde = pd->log()[pdi(addr)];
+        if(!(pde & Page_Flags::V))
+            return false;
+        if(leaf(pde))
+            return granted(addr, pde, access);
+        Attacher * at = pde2phy(pde);
+        AT_Entry ate = at->log()[ati(addr)];
+        if(!(ate & Page_Flags::V))
+            return false;
+        if(leaf(ate))
+            return granted(addr, ate, access);
+        Page_Table * pt = ate2phy(ate);
+        volatile Reg * pte = reinterpret_cast<volatile Reg *>(&pt->log()[pti(addr)]);
+        Reg entry = *pte;
+        Phy_Addr frame;
+
+        if(granted(addr, entry, access))
+            return true;
+        if(!(entry & Page_Flags::V) && (entry & (Page_Flags::R | Page_Flags::W | Page_Flags::X)) && ((entry & Page_Flags::CW) != Page_Flags::CW)) { // not a guard
+            frame = alloc(1, Color(pte2phy(entry) >> PT_SHIFT));
+            if(!frame)
+                return false;
+            memset(phy2log(frame), 0, sizeof(Frame));
+
+            if(CPU::cas(*pte, entry, Reg(phy2pte(frame, pte2flg(entry) | Page_Flags::V))) != entry)
+                free(frame); // another CPU backed it first
+        } else if((entry & Page_Flags::V) && ((entry & Page_Flags::CW) == Page_Flags::CW) && (access & Flags::WR)) {
+            Phy_Addr shared = pte2phy(entry);
+            Page_Flags flags = (pte2flg(entry) & ~Page_Flags::CW) | Page_Flags::W;
+            Phy_Addr copy = false;
+            Reg result;
+            do { // the last owner just takes the frame over, so a copy is only made while others might remain
+                if(!copy && _free.shared(shared)) {
+                    copy = alloc(1, phy2color(shared));
+                    if(!copy)
+                        return false;
+                    memcpy(phy2log(copy), phy2log(shared), sizeof(Frame));
+                }
+                result = _free.unshare(shared, pte, entry, Reg(phy2pte(shared, flags)), copy ? Reg(phy2pte(copy, flags)) : Reg(0));
+            } while(result == entry); // shared again (by a clone) after the check above
+            if(copy && (result != Reg(phy2pte(copy, flags))))
+                free(copy); // the last owner after all, or another CPU resolved it first
+            frame = pte2phy(result);
+        } else
+            return false;
+
+        flush_tlb(addr);
+
+        db<MMU>(TRC) << "MMU::fault(addr=" << addr << ") => " << frame << endl;
+
+        return true;
+    }
+
+    // Whether a valid entry already grants the access, in which case the fault was raced or hit a stale TLB entry
+    static bool granted(Log_Addr addr, Reg entry, Flags access) {
+        Reg needed = (access & Flags::WR) ? Page_Flags::W : (access & Flags::EX) ? Page_Flags::X : Page_Flags::R;
+        if(!(entry & Page_Flags::V) || !(entry & needed))
+            return false;
+        flush_tlb_current(addr); // the stale entry is the faulting address space's
+        return true;
+    }
+
+    // Invalidates (on) or revalidates (off) the page that contains addr in the current directory, so accesses to it
+    // fault (e.g. a guard page under a stack); guarded entries keep their frame and are tagged with CW while invalid
+    // Only pages mapped by page tables can be guarded, not those in superpages (such as the flat memory map)
+    static bool guard(Log_Addr addr, bool on) {
         Page_Directory * pd = current();
-        Attacher * at = pd->log()[pdi(addr)];
-        Page_Table * pt = at->log()[ati(addr)];
-        return pt->log()[pti(addr)] | off(addr);
+        PD_Entry pde = pd->log()[pdi(addr)];
+        if(!(pde & Page_Flags::V) || leaf(pde))
+            return false;
+        Attacher * at = pde2phy(pde);
+        AT_Entry ate = at->log()[ati(addr)];
+        if(!(ate & Page_Flags::V) || leaf(ate))
+            return false;
+        Page_Table * pt = ate2phy(ate);
+        PT_Entry & pte = pt->log()[pti(addr)];
+
+        if(on) {
+            if(!leaf(pte) || ((pte & Page_Flags::CW) == Page_Flags::CW))
+                return false;
+            pte = (pte & ~Page_Flags::V) | Page_Flags::CW;
+        } else {
+            if((pte & Page_Flags::V) || ((pte & Page_Flags::CW) != Page_Flags::CW))
+                return false;
+            pte = (pte & ~Page_Flags::CW) | Page_Flags::V;
+        }
+        flush_tlb(addr);
+
+        db<MMU>(TRC) << "MMU::guard(addr=" << addr << ",on=" << on << ")" << endl;
+
+        return true;
+    }
+
+    // Physical address of the 2 MB superpage (megapage) that can replace a page table, i.e. if its entries map
+    // consecutive frames with the same permissions starting at a megapage boundary, or 0 otherwise
+    // Directories copy the leaf when the chunk is attached, so Chunk::reflag() only affects later attachments
+    static Phy_Addr superpage(Phy_Addr pt) {
+        if(!superpages)
+            return Phy_Addr(false);
+
+        Page_Table * t = pt;
+        PT_Entry first = t->log()[0];
+        Phy_Addr base = pte2phy(first);
+        if(!leaf(first) || ((first & Page_Flags::CW) == Page_Flags::CW) || (base & (sizeof(Big_Page) - 1))) // copy-on-write pages must fault on their own
+            return Phy_Addr(false);
+
+        for(unsigned int i = 1; i < PT_ENTRIES; i++) {
+            PT_Entry pte = t->log()[i];
+            if((pte2phy(pte) != base + i * sizeof(Page)) || ((pte2flg(pte) | Page_Flags::A | Page_Flags::D) != (pte2flg(first) | Page_Flags::A | Page_Flags::D)))
+                return Phy_Addr(false);
+        }
+
+        return base;
     }
 
     static PT_Entry   phy2pte(Phy_Addr frame, Page_Flags flags) { return (frame >> 2) | flags; }
@@ -519,6 +722,15 @@ public:
     static Phy_Addr   pde2phy(PD_Entry entry) { return (entry & ~Page_Flags::MASK) << 2; }
     static Page_Flags pde2flg(PT_Entry entry) { return (entry & Page_Flags::MASK); }
 
+    // Entry of a page whose frame is shared copy-on-write: read-only until its first write faults (see fault())
+    static PT_Entry cow(PT_Entry entry) { return (entry & ~Page_Flags::W) | Page_Flags::CW; }
+
+    // Entry of a lazy page that was not touched yet: invalid, but keeping the page's flags and, in place of the frame number, its color
+    static PT_Entry lazy(Page_Flags flags, Color color) { return phy2pte(Phy_Addr(color * sizeof(Page)), flags & ~Page_Flags::V); }
+
+    // Valid entries with any of R, W or X set are leaves (pages, megapages or gigapages), the others point to tables
+    static bool leaf(PT_Entry entry) { return (entry & Page_Flags::V) && (entry & (Page_Flags::R | Page_Flags::W | Page_Flags::X)); }
+
 #ifdef __setup__
     // SETUP may use the MMU to build a primordial memory model before turning the MMU on, so no log vs phy adjustments are made
     static Log_Addr phy2log(Phy_Addr phy) { return Log_Addr((RAM_BASE == PHY_MEM) ? phy : (RAM_BASE > PHY_MEM) ? phy : phy ); }
@@ -528,29 +740,73 @@ public:
     static Phy_Addr log2phy(Log_Addr log) { return Phy_Addr((RAM_BASE == PHY_MEM) ? log : (RAM_BASE > PHY_MEM) ? log + (RAM_BASE - PHY_MEM) : log - (PHY_MEM - RAM_BASE)); }
 #endif
 
-    static Color phy2color(Phy_Addr phy) { return static_cast<Color>(colorful ? ((phy >> PT_SHIFT) & 0x7f) % COLORS : WHITE); } // TODO: what is 0x7f
+    static Color phy2color(Phy_Addr phy) { return static_cast<Color>(colorful ? (phy >> PT_SHIFT) % COLORS : WHITE); }
 
     static Color log2color(Log_Addr log) {
         if(colorful) {
-            Page_Directory * pd = current();
-            Page_Table * pt = pd->log()[pdi(log)];
-            Phy_Addr phy = pt->log()[pti(log)] | off(log);
-            return static_cast<Color>(((phy >> PT_SHIFT) & 0x7f) % COLORS);
+            Phy_Addr phy = walk(current(), log);
+            return static_cast<Color>((phy >> PT_SHIFT) % COLORS);
         } else
             return WHITE;
     }
 
 private:
-    static Phy_Addr pd() { return CPU::satp() << PT_SHIFT; }
-    static void pd(Phy_Addr pd) { CPU::satp((1UL << 63) | (pd >> PT_SHIFT)); }
+    // Translates addr through pd, stopping at the first leaf (gigapages and megapages included)
+    static Phy_Addr walk(Page_Directory * pd, Log_Addr addr) {
+        PD_Entry pde = pd->log()[pdi(addr)];
+        if(leaf(pde))
+            return pde2phy(pde) | (addr & (sizeof(Huge_Page) - 1));
+        Attacher * at = pde2phy(pde);
+        AT_Entry ate = at->log()[ati(addr)];
+        if(leaf(ate))
+            return ate2phy(ate) | (addr & (sizeof(Big_Page) - 1));
+        Page_Table * pt = ate2phy(ate);
+        return pte2phy(pt->log()[pti(addr)]) | off(addr);
+    }
+
+    static Phy_Addr pd() { return (CPU::satp() & PPN_MASK) << PT_SHIFT; }
+    static void pd(Phy_Addr pd) { CPU::satp(MODE | (pd >> PT_SHIFT)); CPU::flush_tlb(); }
+    static void pd(Phy_Addr pd, unsigned int asid, bool flush) {
+        CPU::satp(MODE | (Reg(asid) << ASID_SHIFT) | (pd >> PT_SHIFT));
+        if(flush)
+            CPU::flush_tlb();
+    }
+
+    // ASID of a directory's tag (see ASID_Allocator), probing how many ASIDs the hardware implements on first use
+    static unsigned int asid(volatile ASIDs::Tag * tag, bool * flush) {
+        if(!asids) {
+            *flush = true;
+            return 0;
+        }
+        if(!_asids.size()) { // satp keeps only the implemented bits of an all-ones ASID
+            Reg satp = CPU::satp();
+            CPU::satp(satp | (ASID_MASK << ASID_SHIFT));
+            _asids.size(((CPU::satp() >> ASID_SHIFT) & ASID_MASK) + 1);
+            CPU::satp(satp);
+        }
+        return _asids.asid(tag, flush);
+    }
 
     static void flush_tlb() { CPU::flush_tlb(); }
+
+    // Chunks' page tables are shared by every address space the segment is attached to, so changes to their entries
+    // are flushed for all ASIDs
     static void flush_tlb(Log_Addr addr) { CPU::flush_tlb(addr); }
 
+    // Flushes only the current ASID's entry, for those known to be cached by the current address space alone (global
+    // mappings, outside of the application's range, are flushed for all ASIDs anyway)
+    static void flush_tlb_current(Log_Addr addr) {
+        if(asids && (addr >= APP_LOW) && (addr <= APP_HIGH))
+            CPU::flush_tlb(addr, (CPU::satp() >> ASID_SHIFT) & ASID_MASK);
+        else
+            CPU::flush_tlb(addr);
+    }
+
     static void init();
 
 private:
-    static List _free[colorful * COLORS + 1]; // +1 for WHITE
+    static Buddy _free;
+    static ASIDs _asids;
     static Page_Directory * _master;
 };
 
@@ -24,6 +24,8 @@ public:
 
     using Engine::Interrupt_Id;
     using Engine::Interrupt_Handler;
+    using Engine::on_interrupt_stack;
+    using Engine::defer_reschedule;
 
     using Engine::INT_SYS_TIMER;
     using Engine::INT_USR_TIMER;
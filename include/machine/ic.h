@@ -65,6 +65,10 @@ public:
     static Interrupt_Id int2irq(Interrupt_Id i);       // Offset INTs as seen by the CPU to IRQs seen by the bus (if needed)
 
     static void ipi(unsigned int cpu, Interrupt_Id i); // Inter-processor Interrupt
+
+    // Handlers that run on a dedicated interrupt stack can't switch threads there, so they defer rescheduling
+    static bool on_interrupt_stack() { return false; }
+    static void defer_reschedule() {}
 };
 
 __END_SYS
@@ -20,6 +20,10 @@ template<> struct Traits<Machine>: public Traits<Machine_Common>
     static const unsigned int MIO_BASE          = NOT_USED;	// defined by SETUP during PCI initialization (max 244 MB)
     static const unsigned int MIO_TOP           = NOT_USED;	// defined by SETUP
 
+    // Last-level cache geometry (for page coloring)
+    static const unsigned int LLC_SIZE          = 2 * 1024 * 1024; // 2 MB, 16 ways
+    static const unsigned int LLC_WAYS          = 16;
+
     // Physical Memory at Boot
     static const unsigned int BOOT              = 0x00007c00;
     static const unsigned int IMAGE             = 0x00008000;
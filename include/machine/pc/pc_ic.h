@@ -474,6 +474,8 @@ private:
 public:
     using IC_Common::Interrupt_Id;
     using IC_Common::Interrupt_Handler;
+    using IC_Common::on_interrupt_stack;
+    using IC_Common::defer_reschedule;
 
     enum {
         INT_FIRST_HARD  = Engine::INT_FIRST_HARD,
@@ -138,6 +138,9 @@ private:
     typedef CPU::Reg Reg;
 
     static const bool supervisor = Traits<Machine>::supervisor;
+    static const bool interrupt_stacks = Traits<IC>::interrupt_stacks;
+    static const unsigned int STACK_SIZE = Traits<IC>::STACK_SIZE;
+    static const unsigned int CPUS = Traits<Machine>::CPUS;
 
 public:
     static const unsigned int EXCS = CPU::EXCEPTIONS;
@@ -263,9 +266,19 @@ public:
 
     static void ipi_eoi(Interrupt_Id i) { msip(CPU::id()) = 0; }
 
+    // Handlers run on the CPU's interrupt stack (see entry()), which cannot hold a thread's context, so rescheduling
+    // requested by them is deferred until the outermost one is back on the interrupted thread's stack
+    static bool on_interrupt_stack() { return interrupt_stacks && _nesting[CPU::id()]; }
+    static void defer_reschedule() { _deferred[CPU::id()] = true; }
+
 private:
     static void dispatch();
 
+    // Interrupt stack switching (see entry())
+    static Reg stack_enter(Reg sp);
+    static Reg stack_leave(Reg sp);
+    static void preempt();
+
     // Logical handlers
     static void int_not(Interrupt_Id i);
     static void exception(Interrupt_Id i);
@@ -277,6 +290,10 @@ private:
 
 private:
     static Interrupt_Handler _int_vector[INTS];
+    static char _stack[interrupt_stacks ? CPUS : 1][interrupt_stacks ? STACK_SIZE : 1];
+    static Reg _sp[CPUS];
+    static unsigned int _nesting[CPUS];
+    static volatile bool _deferred[CPUS];
 };
 
 __END_SYS
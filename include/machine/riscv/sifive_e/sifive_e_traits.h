@@ -35,6 +35,10 @@ public:
     static const unsigned long MIO_BASE         = 0x00000000;
     static const unsigned long MIO_TOP          = 0x1fffffff;                           // 512 MB (max 512 MB of MIO => RAM + MIO < 2 G)
 
+    // Last-level cache geometry (for page coloring)
+    static const unsigned long LLC_SIZE         = 0;                                    // FE310 has no data cache
+    static const unsigned int LLC_WAYS          = 1;
+
     // Physical Memory at Boot
     static const unsigned long BOOT             = NOT_USED;
     static const unsigned long SETUP            = NOT_USED;
@@ -61,6 +65,10 @@ template <> struct Traits<IC>: public Traits<Machine_Common>
 {
     static const bool debugged = hysterically_debugged;
 
+    // Run handlers on a per-CPU interrupt stack, so thread stacks need no room for them
+    static const bool interrupt_stacks = true;
+    static const unsigned int STACK_SIZE = 1024;
+
     static const unsigned int PLIC_IRQS = 53;           // IRQ0 is used by PLIC to signalize that there is no interrupt being serviced or pending
 
     struct Interrupt_Source: public _SYS::Interrupt_Source {
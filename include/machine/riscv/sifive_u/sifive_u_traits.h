@@ -38,6 +38,10 @@ public:
     static const unsigned long MIO_BASE         = 0x00000000;
     static const unsigned long MIO_TOP          = 0x1fffffff;                                   // 512 MB
 
+    // Last-level cache geometry (for page coloring)
+    static const unsigned long LLC_SIZE         = 2 * 1024 * 1024;                              // FU540-C000 L2 cache: 2 MB, 16 ways
+    static const unsigned int LLC_WAYS          = 16;
+
     // Physical Memory at Boot
     static const unsigned long BOOT             = NOT_USED;
     static const unsigned long SETUP            = NOT_USED;
@@ -64,6 +68,10 @@ template <> struct Traits<IC>: public Traits<Machine_Common>
 {
     static const bool debugged = hysterically_debugged;
 
+    // Run handlers on a per-CPU interrupt stack, so thread stacks need no room for them
+    static const bool interrupt_stacks = true;
+    static const unsigned int STACK_SIZE = 4 * 1024;
+
     static const unsigned int PLIC_IRQS = 54;           // IRQ0 is used by PLIC to signalize that there is no interrupt being serviced or pending
 
     struct Interrupt_Source: public _SYS::Interrupt_Source {
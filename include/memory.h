@@ -24,6 +24,7 @@ public:
     Log_Addr attach(Segment * seg, Log_Addr addr);
     void detach(Segment * seg);
     void detach(Segment * seg, Log_Addr addr);
+    long resize(Segment * seg, Log_Addr addr, long amount); // resizes a segment attached at addr (see Segment::resize())
 
     Phy_Addr physical(Log_Addr address);
 };
@@ -40,13 +41,14 @@ public:
     typedef MMU::Flags Flags;
 
 public:
-    Segment(unsigned long bytes, Flags flags = Flags::APPD);
+    Segment(unsigned long bytes, Flags flags = Flags::APPD, Color color = WHITE);
+    Segment(Segment * seg, Flags flags = Flags::APPD); // copy-on-write clone (attaching it gives an address space a private view of seg)
     Segment(Phy_Addr phy_addr, unsigned long bytes, Flags flags);
     ~Segment();
 
     unsigned long size() const;
     Phy_Addr phy_address() const;
-    long resize(long amount);
+    long resize(long amount, Color color = WHITE); // attached segments must be resized through Address_Space::resize()
     void reflag(Flags flags);
 };
 
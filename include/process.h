@@ -8,6 +8,7 @@
 #include <utility/queue.h>
 #include <utility/handler.h>
 #include <scheduler.h>
+#include <system.h>
 
 extern "C" { void __exit(); }
 
@@ -22,12 +23,16 @@ class Thread
     friend class Alarm;                 // for lock()
     friend class System;                // for init()
     friend class Balanced_Queue_Scheduler;
+    friend class IC;                    // for reschedule() deferred by interrupt handlers
 
 protected:
     static const bool preemptive = Traits<Thread>::Criterion::preemptive;
     static const int priority_inversion_protocol = Traits<Thread>::priority_inversion_protocol;
     static const unsigned int QUANTUM = Traits<Thread>::QUANTUM;
     static const unsigned int STACK_SIZE = Traits<Application>::STACK_SIZE;
+    static const bool stack_painting = Traits<Thread>::stack_painting;
+    static const bool stack_guard = Traits<Thread>::stack_guard && (sizeof(MMU::Page) > 1); // No_MMU has no pages to guard
+    static const unsigned char STACK_PAINT = 0xa5;
 
     typedef CPU::Log_Addr Log_Addr;
     typedef CPU::Context Context;
@@ -60,12 +65,13 @@ public:
 
     // Thread Configuration
     struct Configuration {
-        Configuration(State s = READY, Criterion c = NORMAL, unsigned int ss = STACK_SIZE)
-        : state(s), criterion(c), stack_size(ss) {}
+        Configuration(State s = READY, Criterion c = NORMAL, unsigned int ss = STACK_SIZE, Color cl = WHITE)
+        : state(s), criterion(c), stack_size(ss), color(cl) {}
 
         State state;
         Criterion criterion;
         unsigned int stack_size;
+        Color color;            // of the stack's frames (with Traits<MMU>::colorful), to keep it in the cache partition of its core
     };
 
 
@@ -76,6 +82,11 @@ public:
     Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an);
     ~Thread();
 
+    // new (SYSTEM) takes objects from an Object_Cache (see system.h)
+    void * operator new(size_t bytes) { return ::operator new(bytes); }
+    void * operator new(size_t bytes, void * ptr) { return ptr; }
+    void * operator new(size_t bytes, const System_Allocator & allocator);
+
     const volatile State & state() const { return _state; }
     Criterion & criterion() { return const_cast<Criterion &>(_link.rank()); }
     volatile Criterion::Statistics & statistics() { return criterion().statistics(); }
@@ -85,6 +96,11 @@ public:
 
     Task * task() const { return _task; }
 
+    unsigned int stack_size() const { return _stack_size; }
+
+    // Deepest the stack has ever gone, in bytes (0 without Traits<Thread>::stack_painting)
+    unsigned int stack_high_water() const;
+
     int join();
     void pass();
     void suspend();
@@ -95,7 +111,7 @@ public:
     static void exit(int status = 0);
 
 protected:
-    void constructor_prologue(unsigned int stack_size);
+    void constructor_prologue(unsigned int stack_size, Color color = WHITE);
     void constructor_epilogue(Log_Addr entry, unsigned int stack_size);
 
     Thread_Queue::Element * link() { return &_link; }
@@ -111,7 +127,10 @@ protected:
 
     static void sleep(Thread_Queue * queue);
     static void wakeup(Thread_Queue * queue);
+    static void wakeup(Thread * thread);
     static void wakeup_all(Thread_Queue * queue);
+    static void requeue(Thread * thread, Thread_Queue * queue);
+    static bool waiting(Thread * thread, Thread_Queue * queue) { return (thread->_state == WAITING) && (thread->_waiting == queue); }
 
     static void acquire_synchronizer(Synchronizer_Common * synchronizer);
     static void release_synchronizer(Synchronizer_Common * synchronizer);
@@ -141,6 +160,7 @@ protected:
     Task * _task;
 
     char * _stack;
+    unsigned int _stack_size;
     Context * volatile _context;
     volatile State _state;
     Thread_Queue * _waiting;
@@ -163,6 +183,11 @@ class Task
     friend class Mutex;            // for enroll() and dismiss()
     friend class Condition;        // for enroll() and dismiss()
     friend class Semaphore;        // for enroll() and dismiss()
+    friend class RW_Lock;          // for enroll() and dismiss()
+    friend class Condition_Variable; // for enroll() and dismiss()
+    friend class Barrier;          // for enroll() and dismiss()
+    friend class Latch;            // for enroll() and dismiss()
+    friend class Channel;          // for enroll() and dismiss()
     friend class Segment;          // for enroll() and dismiss()
 
 private:
@@ -192,7 +217,7 @@ private:
     template<typename T>
     void enroll(T * o) {
     	db<Task>(TRC) << "Task::enroll(t=" << Type<T>::ID << ", o=" << o << ")" << endl;
-    	_resources.insert(new (SYSTEM) Resource(o, Type<T>::ID));
+    	_resources.insert(Object_Cache<Resource>::create(o, Type<T>::ID));
     }
     void dismiss(void * o) {
     	db<Task>(TRC) << "Task::dismiss(" << o << ")" << endl;
@@ -226,7 +251,7 @@ template<typename ... Tn>
 inline Thread::Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an)
 : _task(Task::self()), _state(conf.state), _waiting(0), _joining(0), _link(this, conf.criterion), _acquired_synchronizers(0)
 {
-    constructor_prologue(conf.stack_size);
+    constructor_prologue(conf.stack_size, conf.color);
     _context = CPU::init_stack(0, _stack + conf.stack_size, &__exit, entry, an ...);
     constructor_epilogue(entry, conf.stack_size);
 }
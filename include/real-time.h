@@ -6,6 +6,7 @@
 #include <utility/handler.h>
 #include <utility/math.h>
 #include <utility/convert.h>
+#include <utility/arena.h>
 #include <time.h>
 #include <process.h>
 #include <synchronizer.h>
@@ -20,6 +21,8 @@ typedef Thread Aperiodic_Thread;
 // threads are created in BEGINNING state, so the scheduler won't dispatch
 // them before the associate alarm and semaphore are created. The first job
 // is dispatched by resume() (thus the _state = SUSPENDED statement)
+// Threads configured with an arena_size get a job arena (see arena()), from
+// which jobs allocate their temporaries; wait_next() resets it after each job
 
 // Periodic Thread
 class Periodic_Thread: public Thread
@@ -61,11 +64,12 @@ protected:
 
 public:
     struct Configuration: public Thread::Configuration {
-        Configuration(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, const unsigned int n = INFINITE, State s = READY, unsigned int ss = STACK_SIZE)
-        : Thread::Configuration(s, Criterion(p, d, c), ss), activation(a), times(n) {}
+        Configuration(Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, const unsigned int n = INFINITE, State s = READY, unsigned int ss = STACK_SIZE, unsigned int as = 0)
+        : Thread::Configuration(s, Criterion(p, d, c), ss), activation(a), times(n), arena_size(as) {}
 
         Microsecond activation;
         unsigned int times;
+        unsigned int arena_size;        // of the job arena (0 = none)
     };
 
 public:
@@ -79,8 +83,9 @@ public:
 
     template<typename ... Tn>
     Periodic_Thread(Configuration conf, int (* entry)(Tn ...), Tn ... an)
-    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size), entry, an ...),
-      _semaphore(0, false), _handler(&_semaphore, this), _alarm(conf.criterion.period(), &_handler, conf.times) {
+    : Thread(Thread::Configuration(SUSPENDED, conf.criterion, conf.stack_size, conf.color), entry, an ...),
+      _semaphore(0, false), _handler(&_semaphore, this), _alarm(conf.criterion.period(), &_handler, conf.times),
+      _arena(conf.arena_size ? new (SYSTEM) char[conf.arena_size] : 0, conf.arena_size) {
         if((conf.state == READY) || (conf.state == RUNNING)) {
             _state = SUSPENDED;
             resume();
@@ -89,9 +94,17 @@ public:
             _state = conf.state;
     }
 
+    ~Periodic_Thread() {
+        if(_arena.base())
+            delete[] reinterpret_cast<char *>(_arena.base());
+    }
+
     Microsecond period() const { return _alarm.period(); }
     void period(Microsecond p) { _alarm.period(p); }
 
+    // Job-local memory, given back at once when the job finishes (i.e. at wait_next())
+    Arena & arena() { return _arena; }
+
     static volatile bool wait_next() {
         Periodic_Thread * t = reinterpret_cast<Periodic_Thread *>(running());
 
@@ -99,6 +112,10 @@ public:
 
         t->criterion().handle(Criterion::JOB_FINISH);
 
+        if(t->_arena.overflowed())
+            db<Thread>(WRN) << "Thread::wait_next(this=" << t << "): job arena overflowed (size=" << t->_arena.size() << ",overflows=" << t->_arena.overflows() << ")!" << endl;
+        t->_arena.reset();
+
         if(t->_alarm.times())
             t->_semaphore.p();
 
@@ -109,13 +126,14 @@ protected:
     Semaphore _semaphore;
     Handler _handler;
     Alarm _alarm;
+    Arena _arena;
 };
 
 class RT_Thread: public Periodic_Thread
 {
 public:
-    RT_Thread(void (* function)(), Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, int n = INFINITE, unsigned int ss = STACK_SIZE)
-    : Periodic_Thread(Configuration(p, d, c, a, n, SUSPENDED, ss), &entry, this, function, a, n) {
+    RT_Thread(void (* function)(), Microsecond p, Microsecond d = SAME, Microsecond c = UNKNOWN, Microsecond a = NOW, int n = INFINITE, unsigned int ss = STACK_SIZE, unsigned int as = 0)
+    : Periodic_Thread(Configuration(p, d, c, a, n, SUSPENDED, ss, as), &entry, this, function, a, n) {
         resume();
     }
 
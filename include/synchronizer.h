@@ -5,6 +5,7 @@
 
 #include <architecture.h>
 #include <utility/handler.h>
+#include <utility/lock_profiler.h>
 #include <process.h>
 
 __BEGIN_SYS
@@ -50,47 +51,76 @@ protected:
     // Atomic operations
     bool tsl(volatile int & lock) { return CPU::tsl(lock); }
     void asz(volatile int & lock) { CPU::asz(lock); }
+    void asz(volatile long & lock) { CPU::asz(lock); }
     long finc(volatile long & number) { return CPU::finc(number); }
     long fdec(volatile long & number) { return CPU::fdec(number); }
+    long cas(volatile long & value, long compare, long replacement) { return CPU::cas(value, compare, replacement); }
 
     // Thread operations
+    Thread * running() { return Thread::running(); }
+
+    // Plain kernel locking, without priority inversion bookkeeping
+    void begin_atomic() { Thread::lock(); }
+    void end_atomic() { Thread::unlock(); }
+
     void lock_for_acquiring() { Thread::lock(); }
 
     void unlock_for_acquiring() {
-        if (_solve_priority_inversion) {
-            _granted.insert(new (SYSTEM) Thread_Queue::Element(Thread::running()));
-            Thread::acquire_synchronizer(this);
-        }
-
+        if(Traits<Synchronizer>::profiled)
+            Lock_Profiler::granted(this);
+        grant();
         Thread::unlock();
     }
 
     void lock_for_releasing() {
         Thread::lock();
+        revoke();
+    }
 
+    void unlock_for_releasing() { Thread::unlock(); }
+
+    // Priority inversion bookkeeping for the running thread (kernel locked)
+    void grant() {
         if (_solve_priority_inversion) {
-            Thread_Queue::Element * e = _granted.remove();
+            _granted.insert(Object_Cache<Thread_Queue::Element>::create(Thread::running()));
+            Thread::acquire_synchronizer(this);
+        }
+    }
+
+    void revoke() {
+        if (_solve_priority_inversion) {
+            Thread_Queue::Element * e = _granted.remove(Thread::running());
+            if(!e)
+                e = _granted.remove();
             if(e) delete e;
             Thread::release_synchronizer(this);
         }
     }
 
-    void unlock_for_releasing() { Thread::unlock(); }
-
-    void sleep() {
+    void sleep() { sleep(&_waiting); }
+    void sleep(Thread_Queue * q) {
+        if(Traits<Synchronizer>::profiled)
+            Lock_Profiler::blocked(this);
         Thread::handle_synchronizer_blocking(this);
-        Thread::sleep(&_waiting);
+        Thread::sleep(q);
     }
 
     void wakeup() { Thread::wakeup(&_waiting); }
+    void wakeup(Thread_Queue * q) { Thread::wakeup(q); }
+    void wakeup(Thread * t) { Thread::wakeup(t); }
 
     void wakeup_all() { Thread::wakeup_all(&_waiting); }
+    void wakeup_all(Thread_Queue * q) { Thread::wakeup_all(q); }
+
+    void requeue(Thread * t, Thread_Queue * q) { Thread::requeue(t, q); }
+    bool waiting(Thread * t) { return Thread::waiting(t, &_waiting); }
+    bool waiting(Thread * t, Thread_Queue * q) { return Thread::waiting(t, q); }
 
     Thread_Queue * waiting() { return &_waiting; }
     Thread_Queue * granted() { return &_granted; }
 
     void save_thread_priority(Thread * t, Criterion p) {
-        _priorities.insert(new (SYSTEM) Priority_Queue::Element(new (SYSTEM) Thread_Priority(t, p)));
+        _priorities.insert(Object_Cache<Priority_Queue::Element>::create(Object_Cache<Thread_Priority>::create(t, p)));
     }
 
     Criterion get_saved_thread_priority(Thread * t) {
@@ -127,6 +157,12 @@ protected:
 
 class Mutex: protected Synchronizer_Common
 {
+    friend class Condition_Variable;    // for release() and _owner
+
+private:
+    static const bool adaptive = Traits<Synchronizer>::adaptive && (Traits<Build>::CPUS > 1);
+    static const unsigned int MAX_SPINS = Traits<Synchronizer>::MAX_SPINS;
+
 public:
     Mutex(bool priority_inversion = true);
     ~Mutex();
@@ -134,8 +170,15 @@ public:
     void lock();
     void unlock();
 
+private:
+    bool spin();
+
+    void release(); // kernel locked
+
 private:
     volatile int _locked;
+    Thread * volatile _owner;
+    unsigned int _spins;        // moving average of the spins that succeeded (adaptive only)
 };
 
 
@@ -145,6 +188,11 @@ public:
     Semaphore(long v = 1, bool priority_inversion = true);
     ~Semaphore();
 
+    // new (SYSTEM) takes objects from an Object_Cache (see system.h)
+    void * operator new(size_t bytes) { return ::operator new(bytes); }
+    void * operator new(size_t bytes, void * ptr) { return ptr; }
+    void * operator new(size_t bytes, const System_Allocator & allocator);
+
     void p();
     void v();
 
@@ -153,7 +201,105 @@ private:
 };
 
 
-// This is actually no Condition Variable
+// An event handler that expires a timed wait on a synchronizer (see handler.h)
+// It must be attached to an Alarm before the kernel is locked for waiting, so it can fire even before the thread sleeps.
+// S::timeout(t) must wake "t" up if it is still waiting and tell whether it did so.
+template<typename S>
+class Timeout_Handler: public Handler
+{
+public:
+    Timeout_Handler(S * s, Thread * t): _synchronizer(s), _thread(t), _fired(false), _expired(false) {}
+    ~Timeout_Handler() {}
+
+    void operator()() {
+        _fired = true;
+        _expired = _synchronizer->timeout(_thread);
+    }
+
+    bool fired() const { return _fired; }     // the alarm went off
+    bool expired() const { return _expired; } // the alarm went off and woke the thread up
+
+private:
+    S * _synchronizer;
+    Thread * _thread;
+    volatile bool _fired;
+    volatile bool _expired;
+};
+
+
+// Readers-Writer Lock
+// Readers share the lock, writers hold it exclusively. While no writer holds (or, with writer
+// preference, waits for) the lock, readers get in and out with a single atomic operation on
+// _state, never touching Thread::lock(). Readers are only tracked in _granted (and therefore
+// subject to priority inversion handling) when a protocol is enabled for this lock.
+// _state: number of readers holding the lock, or WRITER if a writer holds it
+class RW_Lock: protected Synchronizer_Common
+{
+private:
+    enum { WRITER = -1 };
+
+public:
+    RW_Lock(bool writer_preference = Traits<Synchronizer>::writer_preference, bool priority_inversion = true);
+    ~RW_Lock();
+
+    void lock_read();
+    void unlock_read();
+
+    void lock_write();
+    void unlock_write();
+
+private:
+    bool tracked() { return _solve_priority_inversion && (Traits<Thread>::priority_inversion_protocol != Traits<Build>::NONE); }
+    bool try_read();
+    void hand_over_to_writer();
+
+private:
+    volatile long _state;
+    volatile long _writers;     // writers blocked at _waiting
+    Thread_Queue _readers;      // readers blocked while a writer holds or waits for the lock
+    bool _writer_preference;
+};
+
+
+// Reusable Barrier for "count" threads
+// Sense-reversing: the last thread to arrive flips _sense, releasing the others. On multicore builds, threads
+// spin for a while on _sense before blocking, since phases of parallel threads tend to end close together.
+// wait() returns true for exactly one thread (the last to arrive) in each phase.
+class Barrier: protected Synchronizer_Common
+{
+private:
+    static const unsigned int SPINS = (Traits<Build>::CPUS > 1) ? Traits<Synchronizer>::MAX_SPINS : 0;
+
+public:
+    Barrier(unsigned int count);
+    ~Barrier();
+
+    bool wait();
+
+private:
+    unsigned int _count;
+    volatile long _arrived;
+    volatile bool _sense;
+};
+
+
+// Single-use countdown Latch: wait() blocks until count_down() has been called "count" times
+class Latch: protected Synchronizer_Common
+{
+public:
+    Latch(unsigned int count);
+    ~Latch();
+
+    void count_down(unsigned int n = 1);
+    void wait();
+    bool try_wait() { return (_count <= 0); }
+
+private:
+    volatile long _count;
+};
+
+
+// This is actually no Condition Variable (see Condition_Variable below for one bound to a Mutex)
 // check http://www.cs.duke.edu/courses/spring01/cps110/slides/sem/sld002.htm
 class Condition: protected Synchronizer_Common
 {
@@ -167,6 +313,104 @@ public:
 };
 
 
+// Monitor-style Condition Variable
+// wait() atomically releases the Mutex and enqueues the caller under the kernel lock, and returns with the Mutex held.
+// signal() and broadcast() do not wake waiters up to race for the Mutex: they are handed the Mutex if it is free,
+// or else moved to the Mutex's queue, so each of them runs only when it can actually proceed.
+class Condition_Variable: protected Synchronizer_Common
+{
+    friend class Timeout_Handler<Condition_Variable>;   // for timeout()
+
+public:
+    Condition_Variable(bool priority_inversion = true);
+    ~Condition_Variable();
+
+    void wait(Mutex & mutex);
+    bool wait(Mutex & mutex, const Microsecond & timeout); // false on timeout
+    void signal();
+    void broadcast();
+
+private:
+    void transfer(Thread * t);
+    bool timeout(Thread * t);
+
+private:
+    Mutex * _mutex; // the mutex waiters are bound to
+};
+
+
+// Message Channel
+// Channels convey pointers to messages (e.g. Buffers, see utility/buffer.h), thus passing their ownership
+// from senders to receivers without copying them. Senders block while the channel is full and receivers
+// while it is empty. A message sent while receivers are blocked is handed over to the first of them, which
+// is woken up directly and is guaranteed to get it. Channel::select() waits for any of several channels to
+// have messages (a channel can take part in a single select() at a time). Timed operations take a Microsecond timeout: 0 means don't block and INFINITE, forever.
+class Channel: protected Synchronizer_Common
+{
+    friend class Timeout_Handler<Channel>;  // for timeout()
+    friend class Task;                      // for ~Channel()
+
+protected:
+    Channel(void ** ring, unsigned int size);
+    ~Channel();
+
+    bool send(void * message, const Microsecond & timeout);
+    void * receive(const Microsecond & timeout);
+
+public:
+    unsigned int size() const { return _count; }
+    bool empty() const { return (_count == 0); }
+    bool full() const { return (_count == _size); }
+
+    // Returns the index of a channel that has messages or -1 on timeout
+    static int select(Channel * const channels[], unsigned int n, const Microsecond & timeout = INFINITE);
+
+private:
+    bool available() const { return (_count > _promised); }            // messages not promised to woken receivers
+    bool room() const { return (_count + _reserved < _size); }          // slots not reserved for woken senders
+
+    bool send(void * message, bool wait, Timeout_Handler<Channel> * handler);
+    void * receive(bool wait, Timeout_Handler<Channel> * handler);
+    static int select(Channel * const channels[], unsigned int n, bool wait, Timeout_Handler<Channel> * handler);
+
+    void put(void * message);
+    void * get();
+
+    bool timeout(Thread * t);
+
+private:
+    void ** _ring;
+    unsigned int _size;
+    unsigned int _head;
+    volatile unsigned int _count;
+    unsigned int _promised;         // messages handed over to receivers woken up but not yet running
+    unsigned int _reserved;         // slots handed over to senders woken up but not yet running
+    Thread_Queue _senders;          // receivers wait at _waiting
+    Thread_Queue * _selecting;      // threads waiting at select() for this channel
+};
+
+
+// Typed Message Channel of up to N messages
+template<typename T, unsigned int N = 16>
+class Mailbox: public Channel
+{
+public:
+    Mailbox(): Channel(_ring, N) {}
+    ~Mailbox() {}
+
+    void send(T * message) { Channel::send(message, INFINITE); }
+    bool send(T * message, const Microsecond & timeout) { return Channel::send(message, timeout); }
+    bool try_send(T * message) { return Channel::send(message, 0); }
+
+    T * receive() { return reinterpret_cast<T *>(Channel::receive(INFINITE)); }
+    T * receive(const Microsecond & timeout) { return reinterpret_cast<T *>(Channel::receive(timeout)); } // 0 on timeout
+    T * try_receive() { return reinterpret_cast<T *>(Channel::receive(0)); }
+
+private:
+    void * _ring[N];
+};
+
+
 // An event handler that triggers a mutex (see handler.h)
 class Mutex_Handler: public Handler
 {
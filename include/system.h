@@ -14,6 +14,8 @@ class Application
 {
     friend class Init_Application;
     friend void * ::malloc(size_t);
+    friend void * ::realloc(void *, size_t);
+    friend void * ::aligned_alloc(size_t, size_t);
     friend void ::free(void *);
 
 private:
@@ -26,19 +28,27 @@ private:
 
 class System
 {
+    template<typename> friend class Object_Cache;                               // for _heap
     friend class Init_System;                                                   // for _heap
     friend class Init_Application;                                              // for _heap with multiheap = false
     friend void CPU::Context::load() const volatile;
     friend void * ::malloc(size_t);						// for _heap
+    friend void * ::realloc(void *, size_t);					// for _heap
+    friend void * ::aligned_alloc(size_t, size_t);				// for _heap
     friend void ::free(void *);							// for _heap
     friend void * ::operator new(size_t, const EPOS::System_Allocator &);	// for _heap
     friend void * ::operator new[](size_t, const EPOS::System_Allocator &);	// for _heap
+    friend void * ::operator new(size_t, const EPOS::Color &);			// for _heaps
+    friend void * ::operator new[](size_t, const EPOS::Color &);		// for _heaps
     friend void ::operator delete(void *);					// for _heap
     friend void ::operator delete[](void *);					// for _heap
 
 public:
     static System_Info * const info() { assert(_si); return _si; }
 
+    // Gives the free pages at the end of the system's heap segment (with multiheap) back to the MMU; returns how many bytes
+    static unsigned long trim();
+
 private:
     static void init();
 
@@ -46,9 +56,94 @@ private:
     static System_Info * _si;
     static char _preheap[(Traits<System>::multiheap ? sizeof(Segment) : 0) + sizeof(Heap)];
     static Segment * _heap_segment;
+    static char * _heap_address;        // where _heap_segment is attached
     static Heap * _heap;
+    static Heap * _heaps[WHITE];        // colored heaps (with Traits<MMU>::colorful), each backed by frames of its color
 };
 
+
+// Per-type object cache (slab allocator) for kernel objects
+// Objects are carved from slabs of Traits<Heaps>::SLAB_OBJECTS taken from the system heap. Each one starts on a
+// cache line, preceded by a header word that is written once, when the slab is carved, and tags the object as cached,
+// so delete and free() give it back to its cache. Slabs are never returned to the heap. Objects whose size differs
+// from sizeof(T) (e.g. of derived classes) come straight from the system heap.
+template<typename T>
+class Object_Cache: private Object_Cache_Common
+{
+private:
+    static const unsigned int LINE = Traits<CPU>::CACHE_LINE_SIZE;
+    static const unsigned long SLOT = (sizeof(T) + sizeof(long) + LINE - 1) / LINE * LINE;
+    static const unsigned int OBJECTS = Traits<Heaps>::SLAB_OBJECTS;
+
+public:
+    static void * alloc(unsigned long bytes = sizeof(T)) {
+        if(!Traits<Heaps>::object_caches || (bytes != sizeof(T)))
+            return System::_heap->alloc(bytes);
+
+        bool enabled = CPU::int_enabled();
+        _lock.acquire();
+
+        if(!_free)
+            grow();
+
+        void * object = _free;
+        if(object)
+            _free = *reinterpret_cast<void **>(object);
+
+        _lock.release(enabled);
+
+        if(!object && !_tag) // no cache could be enrolled for T
+            object = System::_heap->alloc(bytes);
+
+        return object;
+    }
+
+    template<typename ... Tn>
+    static T * create(Tn ... an) {
+        void * object = alloc();
+        return object ? new (object) T(an ...) : 0;
+    }
+
+private:
+    static void release(void * object) {
+        bool enabled = CPU::int_enabled();
+        _lock.acquire();
+        *reinterpret_cast<void **>(object) = _free;
+        _free = object;
+        _lock.release(enabled);
+    }
+
+    static void grow() {
+        if(!_tag)
+            _tag = enroll(&release);
+        if(!_tag)
+            return;
+
+        char * slab = reinterpret_cast<char *>(System::_heap->alloc(2 * LINE + OBJECTS * SLOT));
+        if(!slab)
+            return;
+
+        db<Heaps>(TRC) << "Object_Cache<" << sizeof(T) << ">::grow(slab=" << reinterpret_cast<void *>(slab) << ")" << endl;
+
+        // The first line holds the header of the first object, which must start on a line boundary
+        char * object = reinterpret_cast<char *>((reinterpret_cast<unsigned long>(slab) + 2 * LINE - 1) / LINE * LINE);
+        for(unsigned int i = 0; i < OBJECTS; i++, object += SLOT) {
+            reinterpret_cast<unsigned long *>(object)[-1] = _tag;
+            *reinterpret_cast<void **>(object) = _free;
+            _free = object;
+        }
+    }
+
+private:
+    static Core_Spin _lock;
+    static void * _free;
+    static unsigned long _tag;
+};
+
+template<typename T> Core_Spin Object_Cache<T>::_lock;
+template<typename T> void * Object_Cache<T>::_free;
+template<typename T> unsigned long Object_Cache<T>::_tag;
+
 __END_SYS
 
 extern "C"
@@ -68,6 +163,37 @@ extern "C"
         return ptr;
     }
 
+    inline void * realloc(void * ptr, size_t bytes) {
+        __USING_SYS;
+        if(Traits<System>::multiheap)
+            return ptr ? Heap::typed_realloc(ptr, bytes) : Application::_heap->alloc(bytes);
+        else
+            return Heap::untyped_realloc(System::_heap, ptr, bytes);
+    }
+
+    inline void * aligned_alloc(size_t alignment, size_t bytes) {
+        __USING_SYS;
+        if(Traits<System>::multiheap)
+            return Application::_heap->alloc(bytes, alignment);
+        else
+            return System::_heap->alloc(bytes, alignment);
+    }
+
+    inline int posix_memalign(void ** ptr, size_t alignment, size_t bytes) {
+        if(!alignment || (alignment & (alignment - 1)) || (alignment % sizeof(void *)))
+            return 22; // EINVAL
+        void * block = aligned_alloc(alignment, bytes);
+        if(!block && bytes)
+            return 12; // ENOMEM
+        *ptr = block;
+        return 0;
+    }
+
+    inline size_t malloc_usable_size(void * ptr) {
+        __USING_SYS;
+        return ptr ? Heap::usable_size(ptr) : 0;
+    }
+
     inline void free(void * ptr) {
         __USING_SYS;
         if(Traits<System>::multiheap)
@@ -94,6 +220,16 @@ inline void * operator new[](size_t bytes, const EPOS::System_Allocator & alloca
     return _SYS::System::_heap->alloc(bytes);
 }
 
+inline void * operator new(size_t bytes, const EPOS::Color & color) {
+    _SYS::Heap * heap = ((color != EPOS::WHITE) && _SYS::System::_heaps[color]) ? _SYS::System::_heaps[color] : _SYS::System::_heap;
+    return heap->alloc(bytes);
+}
+
+inline void * operator new[](size_t bytes, const EPOS::Color & color) {
+    _SYS::Heap * heap = ((color != EPOS::WHITE) && _SYS::System::_heaps[color]) ? _SYS::System::_heaps[color] : _SYS::System::_heap;
+    return heap->alloc(bytes);
+}
+
 // Delete cannot be declared inline due to virtual destructors
 void operator delete(void * ptr);
 void operator delete[](void * ptr);
@@ -187,6 +187,10 @@ constexpr bool INARRAY(const T (& array)[N], const T & value) {
 }
 
 
+// Integer base-2 logarithm (rounded down)
+constexpr unsigned int LOG2(unsigned long n) { return (n > 1) ? 1 + LOG2(n >> 1) : 0; }
+
+
 // SIZEOF Type Package
 template<typename ... Tn>
 struct SIZEOF
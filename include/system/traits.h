@@ -138,7 +138,12 @@ class Synchronizer;
 class Synchronizer_Common;
 class Mutex;
 class Semaphore;
+class RW_Lock;
 class Condition;
+class Condition_Variable;
+class Barrier;
+class Latch;
+class Channel;
 
 class Time;
 class Clock;
@@ -15,7 +15,7 @@ enum Color {
     COLOR_8,  COLOR_9,  COLOR_10, COLOR_11, COLOR_12, COLOR_13, COLOR_14, COLOR_15,
     COLOR_16, COLOR_17, COLOR_18, COLOR_19, COLOR_20, COLOR_21, COLOR_22, COLOR_23,
     COLOR_24, COLOR_25, COLOR_26, COLOR_27, COLOR_28, COLOR_29, COLOR_30, COLOR_31,
-    WHITE = COLOR_0
+    WHITE       // any color
 };
 
 // Power Management Modes
@@ -35,6 +35,10 @@ __END_API
 extern "C"
 {
     void * malloc(size_t);
+    void * realloc(void *, size_t);
+    void * aligned_alloc(size_t, size_t);
+    int posix_memalign(void **, size_t, size_t);
+    size_t malloc_usable_size(void *);
     void free(void *);
 }
 
@@ -177,7 +181,12 @@ enum
     SEGMENT_ID,
     MUTEX_ID,
     SEMAPHORE_ID,
+    RW_LOCK_ID,
     CONDITION_ID,
+    CONDITION_VARIABLE_ID,
+    BARRIER_ID,
+    LATCH_ID,
+    CHANNEL_ID,
     CLOCK_ID,
     ALARM_ID,
     CHRONOMETER_ID,
@@ -241,7 +250,12 @@ template<> struct Type<Segment> { static const Type_Id ID = SEGMENT_ID; };
 
 template<> struct Type<Mutex> { static const Type_Id ID = MUTEX_ID; };
 template<> struct Type<Semaphore> { static const Type_Id ID = SEMAPHORE_ID; };
+template<> struct Type<RW_Lock> { static const Type_Id ID = RW_LOCK_ID; };
 template<> struct Type<Condition> { static const Type_Id ID = CONDITION_ID; };
+template<> struct Type<Condition_Variable> { static const Type_Id ID = CONDITION_VARIABLE_ID; };
+template<> struct Type<Barrier> { static const Type_Id ID = BARRIER_ID; };
+template<> struct Type<Latch> { static const Type_Id ID = LATCH_ID; };
+template<> struct Type<Channel> { static const Type_Id ID = CHANNEL_ID; };
 
 template<> struct Type<Clock> { static const Type_Id ID = CLOCK_ID; };
 template<> struct Type<Chronometer> { static const Type_Id ID = CHRONOMETER_ID; };
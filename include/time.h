@@ -8,6 +8,7 @@
 #include <process.h>
 #include <utility/queue.h>
 #include <utility/handler.h>
+#include <utility/seqlock.h>
 
 __BEGIN_SYS
 
@@ -44,6 +45,11 @@ public:
     Alarm(Microsecond time, Handler * handler, unsigned int times = 1);
     ~Alarm();
 
+    // new (SYSTEM) takes objects from an Object_Cache (see system.h)
+    void * operator new(size_t bytes) { return ::operator new(bytes); }
+    void * operator new(size_t bytes, void * ptr) { return ptr; }
+    void * operator new(size_t bytes, const System_Allocator & allocator);
+
     const Microsecond & period() const { return _time; }
     void period(Microsecond p);
 
@@ -53,10 +59,24 @@ public:
 
     static void delay(Microsecond time);
 
+    static Microsecond now();
+
 private:
     unsigned int times() const { return _times; }
 
-    static volatile Tick & elapsed() { return _elapsed; }
+    // Consistent from any core without locking: _elapsed is only updated by handler() under _time_base
+    static Tick elapsed() {
+        if(sizeof(Tick) <= sizeof(CPU::Reg)) // word-sized reads cannot tear
+            return _elapsed;
+
+        Tick elapsed;
+        unsigned long sequence;
+        do {
+            sequence = _time_base.read_begin();
+            elapsed = _elapsed;
+        } while(_time_base.read_retry(sequence));
+        return elapsed;
+    }
 
     static Alarm_Timer * timer() { return _timer; }
 
@@ -78,6 +98,8 @@ private:
 
     static Alarm_Timer * _timer;
     static volatile Tick _elapsed;
+    static volatile TSC::Time_Stamp _stamp;     // TSC at the last tick, for now()
+    static Seqlock _time_base;
     static Queue _request;
     static Core_Spin _lock;
 };
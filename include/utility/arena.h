@@ -0,0 +1,70 @@
+// EPOS Arena (Region) Allocator Utility Declarations
+
+// Arena hands out memory from a single region by bumping a pointer and takes it all back at once with reset(), so
+// allocating costs a few instructions and nothing ever fragments; blocks cannot be freed individually. Allocations
+// that do not fit fail (returning 0) and mark the arena as overflowed until the next reset(), while peak() tells how
+// large the region should have been. Arenas belong to a single thread (e.g. a periodic job's), so there is no locking.
+
+#ifndef __arena_h
+#define __arena_h
+
+#include <system/config.h>
+
+__BEGIN_UTIL
+
+class Arena
+{
+public:
+    static const unsigned long ALIGN = (sizeof(double) > sizeof(void *)) ? sizeof(double) : sizeof(void *);
+
+public:
+    Arena(void * base = 0, unsigned long size = 0)
+    : _base(reinterpret_cast<char *>(base)), _size(base ? size : 0), _top(0), _peak(0), _overflows(0), _overflowed(false) {}
+
+    void * base() const { return _base; }
+    unsigned long size() const { return _size; }
+    unsigned long used() const { return _top; }
+    unsigned long peak() const { return _peak; }                  // most ever used between resets
+    unsigned long overflows() const { return _overflows; }        // allocations that did not fit, ever
+    bool overflowed() const { return _overflowed; }               // since the last reset
+
+    void * alloc(unsigned long bytes) {
+        bytes = (bytes + ALIGN - 1) & ~(ALIGN - 1);
+        if(bytes > _size - _top) {
+            _overflows++;
+            _overflowed = true;
+            return 0;
+        }
+
+        void * block = _base + _top;
+        _top += bytes;
+        if(_top > _peak)
+            _peak = _top;
+
+        return block;
+    }
+
+    template<typename T, typename ... Tn>
+    T * create(Tn ... an) {
+        void * object = alloc(sizeof(T));
+        return object ? new (object) T(an ...) : 0;
+    }
+
+    // Gives everything back at once (no destructors are called)
+    void reset() {
+        _top = 0;
+        _overflowed = false;
+    }
+
+private:
+    char * _base;
+    unsigned long _size;
+    unsigned long _top;
+    unsigned long _peak;
+    unsigned long _overflows;
+    bool _overflowed;
+};
+
+__END_UTIL
+
+#endif
@@ -0,0 +1,64 @@
+// EPOS Atomic Utility Declarations
+
+// Atomic is a thin, portable layer over the CPU's atomic primitives (CPU::cas, CPU::finc, CPU::fdec),
+// upon which the lock-free utilities (e.g. MPMC_Queue, SPSC_Queue and Lock_Free_Stack) are built.
+// Plain loads and stores are volatile accesses fenced against compiler reordering only. On weakly ordered
+// multicores (e.g. RVWMO, ARM), a store that publishes data to other CPUs must be a store_release() and the
+// load that observes it a load_acquire(), so the data accesses are not reordered across them.
+
+#ifndef __atomic_h
+#define __atomic_h
+
+#include <architecture/cpu.h>
+
+__BEGIN_UTIL
+
+template<typename T>
+class Atomic
+{
+public:
+    Atomic(const T & v = 0): _value(v) {}
+
+    T load() const { T v = _value; barrier(); return v; }
+    void store(const T & v) { barrier(); _value = v; }
+
+    // Later accesses are not performed before this load / earlier accesses are performed before this store
+    T load_acquire() const { T v = _value; CPU::memory_barrier(); return v; }
+    void store_release(const T & v) { CPU::memory_barrier(); _value = v; }
+
+    // Returns the value found, like CPU::cas()
+    T cas(const T & compare, const T & replacement) { return CPU::cas(_value, compare, replacement); }
+    bool compare_and_swap(const T & compare, const T & replacement) { return (cas(compare, replacement) == compare); }
+
+    T finc() { return CPU::finc(_value); }
+    T fdec() { return CPU::fdec(_value); }
+
+    T fadd(const T & n) {
+        T old;
+        do old = _value; while(!compare_and_swap(old, old + n));
+        return old;
+    }
+
+    operator T() const { return load(); }
+
+    static void barrier() { ASM("" : : : "memory"); }
+
+private:
+    volatile T _value;
+};
+
+
+// Keeps an object alone in a cache line to prevent false sharing
+template<typename T, unsigned int LINE = Traits<CPU>::CACHE_LINE_SIZE>
+class Padded: public T
+{
+public:
+    using T::T;
+
+private:
+    char _padding[(LINE > sizeof(T)) ? (LINE - sizeof(T)) : 1];
+};
+
+__END_UTIL
+
+#endif
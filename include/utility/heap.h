@@ -4,39 +4,344 @@
 #define __heap_h
 
 #include <utility/debug.h>
+#include <utility/ostream.h>
 #include <utility/list.h>
 #include <utility/spin.h>
+#include <utility/tlsf.h>
 
 __BEGIN_UTIL
 
+// First-fit allocation engine: an address-ordered Grouping_List merged on free (both linear on the number of free chunks)
+class First_Fit: private Grouping_List<char>
+{
+public:
+    using Grouping_List<char>::empty;
+    using Grouping_List<char>::size;
+    using Grouping_List<char>::grouped_size;
+
+    void * alloc(unsigned long bytes) {
+        if(bytes < sizeof(Element))
+            bytes = sizeof(Element);
+
+        Element * e = search_decrementing(bytes);
+        if(!e)
+            return 0;
+
+        return e->object() + e->size();
+    }
+
+    void free(void * ptr, unsigned long bytes) {
+        if(bytes < sizeof(Element))
+            bytes = sizeof(Element);
+
+        Element * e = new (ptr) Element(reinterpret_cast<char *>(ptr), bytes);
+        Element * m1, * m2;
+        insert_merging(e, &m1, &m2);
+    }
+
+    // Takes a block whose address plus "offset" is a multiple of "align" from the end of the first chunk that holds
+    // it; the tail after the block is given back when it can hold a chunk of its own, else it joins the block
+    // (which is why the size actually taken is returned in "bytes")
+    void * alloc_aligned(unsigned long * bytes, unsigned long align, unsigned long offset = 0) {
+        unsigned long s = (*bytes < sizeof(Element)) ? sizeof(Element) : *bytes;
+
+        for(Element * e = head(); e; e = e->next()) {
+            if(e->size() < s)
+                continue;
+
+            char * start = e->object();
+            char * end = start + e->size();
+            char * block = reinterpret_cast<char *>((reinterpret_cast<unsigned long>(end - s) + offset) & ~(align - 1)) - offset;
+            if((block > start) && (block < start + sizeof(Element))) // what is left before the block must still hold the element
+                block -= (start + sizeof(Element) - block + align - 1) / align * align;
+            if(block < start)
+                continue;
+
+            unsigned long tail = end - (block + s);
+            if(tail < sizeof(Element)) {
+                s += tail;
+                tail = 0;
+            }
+
+            shrink(e, end - block);
+            if(tail)
+                free(block + s, tail);
+
+            *bytes = s;
+            return block;
+        }
+
+        return 0;
+    }
+
+    // Grows the block [ptr, ptr + old_bytes) to "bytes" in place, if the chunk right after it is free and large enough
+    bool grow(void * ptr, unsigned long old_bytes, unsigned long bytes) {
+        if(old_bytes < sizeof(Element))
+            old_bytes = sizeof(Element);
+        if(bytes <= old_bytes)
+            return true;
+
+        Element * e = search(reinterpret_cast<char *>(ptr) + old_bytes);
+        unsigned long more = bytes - old_bytes;
+        if(!e || (e->size() < more) || ((e->size() > more) && (e->size() - more < sizeof(Element))))
+            return false;
+
+        unsigned long left = e->size() - more;
+        shrink(e, e->size()); // the element lies at the chunk's beginning, so what is left needs a new one
+        if(left)
+            free(reinterpret_cast<char *>(ptr) + bytes, left);
+
+        return true;
+    }
+
+    void add(void * ptr, unsigned long bytes) {
+        if(bytes >= sizeof(Element))
+            free(ptr, bytes);
+    }
+
+    unsigned long largest() {
+        unsigned long l = 0;
+        for(Element * e = head(); e; e = e->next())
+            if(e->size() > l)
+                l = e->size();
+        return l;
+    }
+
+    unsigned long trim(void * end, unsigned long unit) {
+        Element * e = search_left(reinterpret_cast<char *>(end));
+        if(!e)
+            return 0;
+
+        unsigned long bytes = e->size() / unit * unit;
+        if(bytes && (e->size() > bytes) && (e->size() - bytes < sizeof(Element))) // what is left must still hold the element
+            bytes -= unit;
+        if(bytes)
+            shrink(e, bytes);
+
+        return bytes;
+    }
+};
+
+
+// Object caches (see Object_Cache in system.h) tag the header word of their objects, so that free() and delete
+// can give them back to the right cache
+class Object_Cache_Common
+{
+    friend class Heap;
+
+protected:
+    typedef void (Release)(void * object);
+
+    static const unsigned long TAG = (1UL << (sizeof(long) * 8 - 1)) | (1UL << (sizeof(long) * 8 - 2));
+    static const unsigned int MAX_CACHES = 32;
+
+protected:
+    // Returns the tag for the cache's objects (or 0 if there is no room left for another cache)
+    static unsigned long enroll(Release * release) {
+        unsigned int i = CPU::finc(_count);
+        if(i >= MAX_CACHES)
+            return 0;
+        _caches[i] = release;
+        return TAG | i;
+    }
+
+private:
+    static bool tagged(unsigned long header) { return (header & TAG) == TAG; }
+    static void release(void * object, unsigned long tag) { _caches[tag & 0xff](object); }
+
+private:
+    static Release * _caches[MAX_CACHES];
+    static volatile unsigned int _count;
+};
+
+
+// Heap usage statistics (Traits<Heaps>::statistics)
+// Cached allocations do not take the heap lock, so counters are updated atomically. Sizes in "in_use" and "peak"
+// include headers; "sizes" counts requests by their size. With Traits<Heaps>::call_sites, allocations are also
+// attributed to the return address of the function that called Heap::alloc() (after inlining, usually the one
+// calling new or malloc()).
+class Heap_Statistics_Common
+{
+public:
+    static const unsigned int SIZES = 12;       // <= 16, <= 32, ..., <= 16 K, larger
+    static const unsigned int SITES = Traits<Heaps>::PROFILED_SITES;
+
+    struct Statistics
+    {
+        unsigned long in_use;                   // bytes currently allocated
+        unsigned long peak;                     // high-water mark of in_use
+        unsigned long allocations;
+        unsigned long frees;
+        unsigned long failures;                 // allocations that could not be served
+        unsigned long sizes[SIZES];             // allocations per power-of-two request size
+        unsigned long free;                     // bytes in the engine's free blocks (magazines not included)
+        unsigned long largest;                  // largest free block
+        unsigned int fragmentation;             // % of the free memory outside the largest free block
+    };
+
+protected:
+    static unsigned int size_class(unsigned long bytes) {
+        unsigned int c = 0;
+        for(bytes = (bytes - 1) >> 4; bytes && (c < SIZES - 1); bytes >>= 1)
+            c++;
+        return c;
+    }
+};
+
+template<bool enabled>
+class Heap_Statistics;
+
+template<>
+class Heap_Statistics<true>: public Heap_Statistics_Common
+{
+private:
+    struct Site
+    {
+        volatile unsigned long site;
+        Atomic<unsigned long> allocations;
+        Atomic<unsigned long> bytes;
+    };
+
+public:
+    Heap_Statistics() {
+        for(unsigned int i = 0; i < SITES; i++)
+            _sites[i].site = 0;
+    }
+
+    void allocated(unsigned long bytes, unsigned long block, void * site) {
+        _allocations.finc();
+        _sizes[size_class(bytes)].finc();
+
+        unsigned long in_use = _in_use.fadd(block) + block;
+        for(unsigned long peak = _peak; in_use > peak; peak = _peak)
+            if(_peak.compare_and_swap(peak, in_use))
+                break;
+
+        if(Traits<Heaps>::call_sites && site) {
+            Site * s = entry(site);
+            if(s) {
+                s->allocations.finc();
+                s->bytes.fadd(bytes);
+            }
+        }
+    }
+
+    void freed(unsigned long block) {
+        _frees.finc();
+        _in_use.fadd(-block);
+    }
+
+    void failed() { _failures.finc(); }
+
+    void fill(Statistics * s) const {
+        s->in_use = _in_use;
+        s->peak = _peak;
+        s->allocations = _allocations;
+        s->frees = _frees;
+        s->failures = _failures;
+        for(unsigned int i = 0; i < SIZES; i++)
+            s->sizes[i] = _sizes[i];
+    }
+
+    // Prints the "n" call sites that allocated the most bytes
+    void report(OStream & os, unsigned int n) const;
+
+private:
+    Site * entry(void * site);
+
+private:
+    Atomic<unsigned long> _in_use;
+    Atomic<unsigned long> _peak;
+    Atomic<unsigned long> _allocations;
+    Atomic<unsigned long> _frees;
+    Atomic<unsigned long> _failures;
+    Atomic<unsigned long> _sizes[SIZES];
+    Site _sites[Traits<Heaps>::call_sites ? SITES : 1];
+    Atomic<unsigned long> _lost;                // allocations of sites that did not fit in _sites
+};
+
+template<>
+class Heap_Statistics<false>: public Heap_Statistics_Common
+{
+public:
+    void allocated(unsigned long bytes, unsigned long block, void * site) {}
+    void freed(unsigned long block) {}
+    void failed() {}
+
+    void fill(Statistics * s) const {
+        s->in_use = s->peak = s->allocations = s->frees = s->failures = 0;
+        for(unsigned int i = 0; i < SIZES; i++)
+            s->sizes[i] = 0;
+    }
+
+    void report(OStream & os, unsigned int n) const {}
+};
+
+
 // Heap
-class Heap: private Grouping_List<char>
+// The allocation engine is selected by Traits<Heaps>::allocator: FIRST_FIT (above) or TLSF (O(1), see utility/tlsf.h)
+// With Traits<Heaps>::cached, small blocks are served from per-CPU magazines, refilled from and flushed to the engine
+// in batches, so most allocations never take the heap lock. Cached blocks remember the CPU whose magazine they came
+// from; blocks freed on another CPU go back to that CPU through a lock-free return list.
+// With Traits<Heaps>::statistics, usage is tracked as well (see statistics() and report()).
+class Heap: private IF<Traits<Heaps>::allocator == Traits<Heaps>::TLSF, TLSF, First_Fit>::Result
 {
+private:
+    typedef IF<Traits<Heaps>::allocator == Traits<Heaps>::TLSF, TLSF, First_Fit>::Result Engine;
+
+    static const bool cached = Traits<Heaps>::cached;
+    static const unsigned int CPUS = cached ? Traits<Build>::CPUS : 1;
+    static const unsigned int CLASSES = 5;
+    static const unsigned long MIN_CLASS = 16;
+    static const unsigned long MAX_CLASS = MIN_CLASS << (CLASSES - 1);
+    static const unsigned int MAGAZINE_SIZE = Traits<Heaps>::MAGAZINE_SIZE;
+    static const unsigned int BATCH = (MAGAZINE_SIZE + 1) / 2;
+
+    // Cached blocks have a tag instead of their size in the header: CACHED | home CPU << 8 | size class
+    static const unsigned long CACHED = 1UL << (sizeof(long) * 8 - 1);
+
+    struct Magazine
+    {
+        unsigned int count;
+        void * blocks[cached ? MAGAZINE_SIZE : 1];
+    };
+
 protected:
     static const bool typed = Traits<System>::multiheap;
 
 public:
-    using Grouping_List<char>::empty;
-    using Grouping_List<char>::size;
-    using Grouping_List<char>::grouped_size;
+    typedef Heap_Statistics_Common::Statistics Statistics;
+
+public:
+    using Engine::empty;
+    using Engine::size;
+    using Engine::grouped_size;
 
     Heap(): _interrupts_enabled(false) {
         db<Init, Heaps>(TRC) << "Heap() => " << this << endl;
+
+        init_cache();
     }
 
     Heap(void * addr, unsigned long bytes): _interrupts_enabled(false) {
         db<Init, Heaps>(TRC) << "Heap(addr=" << addr << ",bytes=" << bytes << ") => " << this << endl;
 
+        init_cache();
         free(addr, bytes);
     }
 
     void * alloc(unsigned long bytes) {
+        if(!bytes)
+            return 0;
+
+        if(cached && (bytes <= MAX_CLASS))
+            return cached_alloc(bytes, __builtin_return_address(0));
+
         lock();
 
         db<Heaps>(TRC) << "Heap::alloc(this=" << this << ",bytes=" << bytes;
 
-        if(!bytes)
-            return 0;
+        unsigned long requested = bytes;
 
         if(!Traits<CPU>::unaligned_memory_access)
             while((bytes % sizeof(void *)))
@@ -45,21 +350,20 @@ public:
         if(typed)
             bytes += sizeof(void *);  // add room for heap pointer
         bytes += sizeof(long);        // add room for size
-        if(bytes < sizeof(Element))
-            bytes = sizeof(Element);
 
-        Element * e = search_decrementing(bytes);
-        if(!e) {
+        long * addr = reinterpret_cast<long *>(Engine::alloc(bytes));
+        if(!addr) {
+            unlock();
             out_of_memory(bytes);
             return 0;
         }
 
-        long * addr = reinterpret_cast<long *>(e->object() + e->size());
-
         if(typed)
             *addr++ = reinterpret_cast<long>(this);
         *addr++ = bytes;
 
+        _statistics.allocated(requested, bytes, __builtin_return_address(0));
+
         db<Heaps>(TRC) << ") => " << reinterpret_cast<void *>(addr) << endl;
 
         unlock();
@@ -67,34 +371,116 @@ public:
         return addr;
     }
 
+    // Allocates a block whose address is a multiple of "align" (a power of two), splitting the free memory before it off
+    void * alloc(unsigned long bytes, unsigned long align);
+
+    // Resizes a block obtained from alloc(), in place whenever it fits or the engine can grow it into the free memory
+    // right after it; otherwise the contents move to a new block (shrinking never moves, nor splits, a block)
+    void * realloc(void * ptr, unsigned long bytes);
+
+    // Bytes that can be used in a block obtained from alloc() (at least those requested)
+    static unsigned long usable_size(void * ptr) {
+        unsigned long bytes = reinterpret_cast<long *>(ptr)[-1];
+        if(Object_Cache_Common::tagged(bytes))
+            return 0;
+        if(cached && (bytes & CACHED))
+            return MIN_CLASS << (bytes & 0xff);
+        return bytes - (typed ? sizeof(void *) : 0) - sizeof(long);
+    }
+
+    // Gives the memory region [ptr, ptr + bytes) to the heap
     void free(void * ptr, unsigned long bytes) {
         lock();
 
         db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << ptr << ",bytes=" << bytes << ")" << endl;
 
-        if(ptr && (bytes >= sizeof(Element))) {
-            Element * e = new (ptr) Element(reinterpret_cast<char *>(ptr), bytes);
-            Element * m1, * m2;
-            insert_merging(e, &m1, &m2);
-        }
+        if(ptr)
+            Engine::add(ptr, bytes);
+
+        unlock();
+    }
+
+    // Takes the free memory at the end of a region given to the heap (i.e. right below "end") off it, in multiples of
+    // "unit" bytes, so the region can be shrunk; returns the number of bytes taken
+    // Blocks held in per-CPU magazines count as used, so they might keep the region from shrinking
+    unsigned long trim(void * end, unsigned long unit) {
+        lock();
+
+        unsigned long bytes = Engine::trim(end, unit);
+
+        db<Heaps>(TRC) << "Heap::trim(this=" << this << ",end=" << end << ",unit=" << unit << ") => " << bytes << endl;
 
         unlock();
+
+        return bytes;
     }
 
     static void typed_free(void * ptr) {
         long * addr = reinterpret_cast<long *>(ptr);
         unsigned long bytes = *--addr;
+        if(Object_Cache_Common::tagged(bytes))
+            return Object_Cache_Common::release(ptr, bytes);
         Heap * heap = reinterpret_cast<Heap *>(*--addr);
-        heap->free(addr, bytes);
+        if(cached && (bytes & CACHED))
+            heap->cached_free(ptr, bytes);
+        else
+            heap->release(addr, bytes);
     }
 
+    static void * typed_realloc(void * ptr, unsigned long bytes) {
+        long * addr = reinterpret_cast<long *>(ptr);
+        assert(!Object_Cache_Common::tagged(addr[-1]));
+        return reinterpret_cast<Heap *>(addr[-2])->realloc(ptr, bytes);
+    }
+
+    static void * untyped_realloc(Heap * heap, void * ptr, unsigned long bytes) { return heap->realloc(ptr, bytes); }
+
     static void untyped_free(Heap * heap, void * ptr) {
         long * addr = reinterpret_cast<long *>(ptr);
         unsigned long bytes = *--addr;
-        heap->free(addr, bytes);
+        if(Object_Cache_Common::tagged(bytes))
+            return Object_Cache_Common::release(ptr, bytes);
+        if(cached && (bytes & CACHED))
+            heap->cached_free(ptr, bytes);
+        else
+            heap->release(addr, bytes);
     }
 
+    Statistics statistics();
+
+    // Prints the statistics and, with Traits<Heaps>::call_sites, the "n" call sites that allocated the most bytes
+    void report(OStream & os, unsigned int n = 10);
+
 private:
+    static unsigned long block_size(unsigned int c) { return (MIN_CLASS << c) + (typed ? sizeof(void *) : 0) + sizeof(long); }
+    static unsigned long tag(unsigned int cpu, unsigned int c) { return CACHED | (cpu << 8) | c; }
+
+    void init_cache() {
+        for(unsigned int i = 0; i < CPUS; i++) {
+            _returned[i] = 0;
+            for(unsigned int j = 0; j < CLASSES; j++)
+                _magazines[i][j].count = 0;
+        }
+    }
+
+    void * cached_alloc(unsigned long bytes, void * site);
+    void cached_free(void * ptr, unsigned long tag);
+    void refill(unsigned int cpu, unsigned int c);
+    void flush(unsigned int cpu, unsigned int c, unsigned int n);
+    void reclaim(unsigned int cpu);
+
+    // Returns a block obtained from alloc() to the engine
+    void release(void * ptr, unsigned long bytes) {
+        lock();
+
+        db<Heaps>(TRC) << "Heap::release(this=" << this << ",ptr=" << ptr << ",bytes=" << bytes << ")" << endl;
+
+        Engine::free(ptr, bytes);
+        _statistics.freed(bytes);
+
+        unlock();
+    }
+
     void out_of_memory(unsigned long bytes);
 
     void lock() {
@@ -107,6 +493,9 @@ private:
 private:
     Core_Spin _lock;
     bool _interrupts_enabled;
+    Magazine _magazines[CPUS][cached ? CLASSES : 1];
+    void * volatile _returned[CPUS];
+    Heap_Statistics<Traits<Heaps>::statistics> _statistics;
 };
 
 __END_UTIL
@@ -1436,7 +1436,15 @@ public:
         return e;
     }
 
-private:
+    // Takes "s" off the end of e (removing it if nothing is left)
+    void shrink(Element * e, unsigned long s) {
+        e->shrink(s);
+        _grouped_size -= s;
+        if(!e->size())
+            remove(e);
+    }
+
+    // Element that ends right before obj
     Element * search_left(const Object_Type * obj) {
         Element * e = head();
         for(; e && (e->object() + e->size() != obj); e = e->next());
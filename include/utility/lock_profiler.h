@@ -0,0 +1,124 @@
+// EPOS Lock Contention Profiler Utility Declarations
+
+// Statistics are gathered per lock address (and, with Traits<Spin>::call_sites, per call site too) by Core_Spin
+// when Traits<Spin>::profiled and by Synchronizer_Common when Traits<Synchronizer>::profiled. Entries of a lock
+// are only updated by its holder (synchronizers update theirs under Thread::lock()), so plain increments suffice;
+// claiming a new entry is the only atomic operation. Times are in TSC ticks.
+
+#ifndef __lock_profiler_h
+#define __lock_profiler_h
+
+#include <architecture/cpu.h>
+#include <architecture/tsc.h>
+#include <utility/ostream.h>
+
+__BEGIN_UTIL
+
+class Lock_Profiler
+{
+public:
+    static const unsigned int ENTRIES = Traits<Spin>::PROFILED_LOCKS;
+
+    typedef TSC::Time_Stamp Time_Stamp;
+
+    struct Entry
+    {
+        volatile unsigned long lock;
+        volatile unsigned long site;
+        unsigned long acquisitions;
+        unsigned long contentions;      // acquisitions that had to spin (or to block, for synchronizers)
+        unsigned long blocked;          // threads put to sleep (synchronizers only)
+        Time_Stamp spin;
+        Time_Stamp max_spin;
+        Time_Stamp hold;
+    };
+
+public:
+    static Entry * entry(const volatile void * lock, void * site = 0);
+
+    // Synchronizer_Common events (kernel locked)
+    static void granted(const volatile void * synchronizer) {
+        Entry * e = entry(synchronizer);
+        if(e)
+            e->acquisitions++;
+    }
+
+    static void blocked(const volatile void * synchronizer) {
+        Entry * e = entry(synchronizer);
+        if(e) {
+            e->contentions++;
+            e->blocked++;
+        }
+    }
+
+    // Prints the "n" most contended locks
+    static void report(OStream & os, unsigned int n = 10);
+    static void reset();
+
+private:
+    static const unsigned long CLAIMING = ~0UL;  // lock of an entry whose site is still being set
+
+private:
+    static Entry _entries[ENTRIES];
+    static volatile unsigned long _lost;        // events of locks that did not fit in _entries
+};
+
+
+// Probe embedded in each profiled lock
+template<bool enabled>
+class Lock_Probe
+{
+public:
+    typedef Lock_Profiler::Time_Stamp Time_Stamp;
+
+public:
+    Lock_Probe(): _entry(0), _since(0) {}
+
+    Time_Stamp start() { return TSC::time_stamp(); }
+
+    // Outermost acquisition only (the lock is already held)
+    void acquired(const volatile void * lock, const Time_Stamp & start, bool contended, void * site) {
+        Time_Stamp now = TSC::time_stamp();
+
+        _entry = Lock_Profiler::entry(lock, Traits<Spin>::call_sites ? site : 0);
+        if(_entry) {
+            _entry->acquisitions++;
+            if(contended) {
+                Time_Stamp spin = now - start;
+                _entry->contentions++;
+                _entry->spin += spin;
+                if(spin > _entry->max_spin)
+                    _entry->max_spin = spin;
+            }
+        }
+        _since = now;
+    }
+
+    // Outermost release only (the lock is still held)
+    void released() {
+        if(_entry) {
+            _entry->hold += TSC::time_stamp() - _since;
+            _entry = 0;
+        }
+    }
+
+private:
+    Lock_Profiler::Entry * _entry;
+    Time_Stamp _since;
+};
+
+template<>
+class Lock_Probe<false>
+{
+public:
+    typedef Lock_Profiler::Time_Stamp Time_Stamp;
+
+public:
+    Time_Stamp start() { return 0; }
+    void acquired(const volatile void * lock, const Time_Stamp & start, bool contended, void * site) {}
+    void released() {}
+};
+
+__END_UTIL
+
+#endif
@@ -0,0 +1,258 @@
+// EPOS Fixed-size Block Pool Utility Declarations
+
+// Block_Pool hands out blocks of a single size carved from a region given at construction (e.g. a static array or
+// an attached Segment) or taken once from the heap. Free blocks form a Treiber stack linked by block index through
+// their first word, and the top word carries an ABA tag next to the index (as in Index_Stack), so alloc() and free()
+// are O(1), lock-free and never fragment. Memory_Pool<T, N> is the statically sized version for objects of type T,
+// with the storage inside the pool and the free list in an Index_Stack<N>, and Pooled<T, N> binds T's operator new
+// and delete to a Memory_Pool of its own.
+// Both pools optionally keep statistics (enabled per pool, at construction), at the cost of a few atomic increments.
+
+#ifndef __pool_h
+#define __pool_h
+
+#include "atomic.h"
+#include "stack.h"
+
+__BEGIN_UTIL
+
+class Pool_Statistics
+{
+public:
+    struct Statistics
+    {
+        unsigned long in_use;                   // blocks currently allocated
+        unsigned long peak;                     // high-water mark of in_use
+        unsigned long allocations;
+        unsigned long frees;
+        unsigned long failures;                 // allocations that found the pool empty
+    };
+
+public:
+    Pool_Statistics(bool enabled): _enabled(enabled), _in_use(0), _peak(0), _allocations(0), _frees(0), _failures(0) {}
+
+    bool enabled() const { return _enabled; }
+
+    void allocated() {
+        if(!_enabled)
+            return;
+        _allocations.finc();
+        unsigned long u = _in_use.finc() + 1;
+        for(unsigned long p = _peak.load(); (u > p) && !_peak.compare_and_swap(p, u); p = _peak.load());
+    }
+
+    void freed() {
+        if(!_enabled)
+            return;
+        _frees.finc();
+        _in_use.fdec();
+    }
+
+    void failed() {
+        if(_enabled)
+            _failures.finc();
+    }
+
+    void fill(Statistics * s) const {
+        s->in_use = _in_use;
+        s->peak = _peak;
+        s->allocations = _allocations;
+        s->frees = _frees;
+        s->failures = _failures;
+    }
+
+private:
+    bool _enabled;
+    Atomic<unsigned long> _in_use;
+    Atomic<unsigned long> _peak;
+    Atomic<unsigned long> _allocations;
+    Atomic<unsigned long> _frees;
+    Atomic<unsigned long> _failures;
+};
+
+
+class Block_Pool
+{
+private:
+    typedef unsigned long Word;
+
+    static const unsigned int INDEX_BITS = sizeof(Word) * 8 / 2;
+    static const Word INDEX_MASK = (Word(1) << INDEX_BITS) - 1;
+    static const unsigned int NIL = -1U;
+
+public:
+    static const unsigned long ALIGN = (sizeof(double) > sizeof(void *)) ? sizeof(double) : sizeof(void *);
+
+    typedef Pool_Statistics::Statistics Statistics;
+
+public:
+    // Carves "count" blocks of (at least) "size" bytes from the region at "base", which must hold count * block_size()
+    Block_Pool(void * base, unsigned long size, unsigned int count, bool statistics = false)
+    : _base(reinterpret_cast<char *>(base)), _size(block_size(size)), _count(count), _owned(false), _statistics(statistics) {
+        init();
+    }
+
+    // Takes the region from the heap, at once
+    Block_Pool(unsigned long size, unsigned int count, bool statistics = false)
+    : _base(new char[block_size(size) * count]), _size(block_size(size)), _count(_base ? count : 0), _owned(true), _statistics(statistics) {
+        init();
+    }
+
+    ~Block_Pool() {
+        if(_owned)
+            delete[] _base;
+    }
+
+    unsigned long block_size() const { return _size; }
+    unsigned int count() const { return _count; }
+    bool empty() const { return index(_top.load()) == NIL; }
+    bool contains(const void * ptr) const {
+        return (reinterpret_cast<const char *>(ptr) >= _base) && (reinterpret_cast<const char *>(ptr) < _base + _size * _count);
+    }
+
+    void * alloc() {
+        Word top;
+        unsigned int i;
+        do {
+            top = _top.load();
+            i = index(top);
+            if(i == NIL) {
+                _statistics.failed();
+                return 0;
+            }
+        } while(!_top.compare_and_swap(top, pack(tag(top) + 1, link(i)))); // a stale link (block already taken) fails on the tag
+        _statistics.allocated();
+
+        return block(i);
+    }
+
+    void free(void * ptr) {
+        if(!ptr)
+            return;
+
+        unsigned int i = (reinterpret_cast<char *>(ptr) - _base) / _size;
+        Word top;
+        do {
+            top = _top.load();
+            link(i) = index(top);
+        } while(!_top.compare_and_swap(top, pack(tag(top) + 1, i)));
+        _statistics.freed();
+    }
+
+    Statistics statistics() const { Statistics s; _statistics.fill(&s); return s; }
+
+private:
+    void init() {
+        assert(_count < INDEX_MASK);
+        for(unsigned int i = 0; i < _count; i++)
+            link(i) = (i < _count - 1) ? i + 1 : NIL;
+        _top.store(pack(0, _count ? 0 : NIL));
+    }
+
+    static unsigned long block_size(unsigned long size) {
+        if(size < sizeof(unsigned int))
+            size = sizeof(unsigned int);
+        return (size + ALIGN - 1) & ~(ALIGN - 1);
+    }
+
+    char * block(unsigned int i) const { return _base + i * _size; }
+    volatile unsigned int & link(unsigned int i) const { return *reinterpret_cast<volatile unsigned int *>(block(i)); }
+
+    static Word pack(Word tag, unsigned int i) { return (tag << INDEX_BITS) | (Word(i) & INDEX_MASK); }
+    static Word tag(Word w) { return w >> INDEX_BITS; }
+    static unsigned int index(Word w) { Word i = w & INDEX_MASK; return (i == INDEX_MASK) ? NIL : i; }
+
+private:
+    char * _base;
+    unsigned long _size;
+    unsigned int _count;
+    bool _owned;
+    Atomic<Word> _top;
+    Pool_Statistics _statistics;
+};
+
+
+template<typename T, unsigned int N>
+class Memory_Pool
+{
+public:
+    typedef Pool_Statistics::Statistics Statistics;
+
+public:
+    Memory_Pool(bool statistics = false): _free(true), _statistics(statistics) {}
+
+    unsigned int count() const { return N; }
+    bool empty() const { return _free.empty(); }
+    bool contains(const void * ptr) const {
+        return (reinterpret_cast<const Slot *>(ptr) >= _slots) && (reinterpret_cast<const Slot *>(ptr) < _slots + N);
+    }
+
+    // Raw storage for a T
+    void * alloc() {
+        unsigned int i = _free.pop();
+        if(i == Index_Stack<N>::NIL) {
+            _statistics.failed();
+            return 0;
+        }
+        _statistics.allocated();
+
+        return &_slots[i];
+    }
+
+    void free(void * ptr) {
+        if(!ptr)
+            return;
+        _free.push(reinterpret_cast<Slot *>(ptr) - _slots);
+        _statistics.freed();
+    }
+
+    template<typename ... Tn>
+    T * create(Tn ... an) {
+        void * object = alloc();
+        return object ? ::new (object) T(an ...) : 0;
+    }
+
+    void destroy(T * object) {
+        if(!object)
+            return;
+        object->~T();
+        free(object);
+    }
+
+    Statistics statistics() const { Statistics s; _statistics.fill(&s); return s; }
+
+private:
+    struct Slot { alignas(T) char storage[sizeof(T)]; };
+
+private:
+    Index_Stack<N> _free;
+    Pool_Statistics _statistics;
+    Slot _slots[N];
+};
+
+
+// Binds T's operator new and delete to a pool of N objects (e.g. class Message: public Pooled<Message, 32>)
+// new returns 0 once the pool is exhausted; objects of classes derived from T must not be larger than T
+template<typename T, unsigned int N>
+class Pooled
+{
+private:
+    // T is still incomplete when Pooled<T, N> is instantiated as its base, so the pool can only be named in functions
+    template<typename U>
+    struct Storage { static Memory_Pool<U, N> pool; };
+
+public:
+    static void * operator new(size_t bytes) noexcept { return (bytes <= sizeof(T)) ? pool().alloc() : 0; }
+    static void * operator new(size_t bytes, void * ptr) { return ptr; }
+    static void operator delete(void * object) { pool().free(object); }
+
+    static Memory_Pool<T, N> & pool() { return Storage<T>::pool; }
+};
+
+template<typename T, unsigned int N>
+template<typename U>
+Memory_Pool<U, N> Pooled<T, N>::Storage<U>::pool;
+
+__END_UTIL
+
+#endif
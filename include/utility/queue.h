@@ -33,12 +33,20 @@
 // definable and for which selecting methods are defined (e.g. choose). This
 // utility is most useful for schedulers, such as CPU or I/O.
 
+// MPMC_Queue and SPSC_Queue are bounded, lock-free rings of SIZE (a power of two)
+// objects, copied in and out by value. MPMC_Queue accepts any number of producers
+// and consumers (D. Vyukov's algorithm: each cell carries a sequence number that
+// tells producers and consumers whether it is theirs). SPSC_Queue is a cheaper
+// variant for a single producer and a single consumer (e.g. an ISR and a thread).
+// Neither of them ever blocks: insert() fails when full and remove() when empty.
+
 #ifndef __queue_h
 #define __queue_h
 
 #include <architecture.h>
 #include "list.h"
 #include "spin.h"
+#include "atomic.h"
 
 __BEGIN_UTIL
 
@@ -96,6 +104,118 @@ template<typename T,
           typename El = List_Elements::Doubly_Linked_Ordered<T, R> >
 class Relative_Queue: public Queue_Wrapper<Relative_List<T, R, El>, false> {};
 
+
+// Lock-free Multiple-Producer, Multiple-Consumer Bounded Queue
+template<typename T, unsigned int SIZE>
+class MPMC_Queue
+{
+private:
+    static const unsigned long MASK = SIZE - 1;
+
+    typedef Atomic<unsigned long> Sequence;
+
+    struct Cell {
+        Sequence sequence;
+        T object;
+    };
+
+public:
+    MPMC_Queue(): _tail(0), _head(0) {
+        static_assert((SIZE >= 2) && !(SIZE & MASK), "MPMC_Queue SIZE must be a power of two");
+        for(unsigned long i = 0; i < SIZE; i++)
+            _cells[i].sequence.store(i);
+    }
+
+    bool empty() const { return (_head.load() == _tail.load()); }
+    unsigned int size() const { return _tail.load() - _head.load(); }
+
+    bool insert(const T & o) {
+        Cell * cell;
+        unsigned long pos = _tail.load();
+        for(;;) {
+            cell = &_cells[pos & MASK];
+            long dif = long(cell->sequence.load_acquire()) - long(pos);
+            if(dif == 0) {
+                if(_tail.compare_and_swap(pos, pos + 1))
+                    break;
+            } else if(dif < 0)
+                return false; // full
+            pos = _tail.load();
+        }
+        cell->object = o;
+        cell->sequence.store_release(pos + 1);
+        return true;
+    }
+
+    bool remove(T * o) {
+        Cell * cell;
+        unsigned long pos = _head.load();
+        for(;;) {
+            cell = &_cells[pos & MASK];
+            long dif = long(cell->sequence.load_acquire()) - long(pos + 1);
+            if(dif == 0) {
+                if(_head.compare_and_swap(pos, pos + 1))
+                    break;
+            } else if(dif < 0)
+                return false; // empty
+            pos = _head.load();
+        }
+        *o = cell->object;
+        cell->sequence.store_release(pos + MASK + 1);
+        return true;
+    }
+
+private:
+    Padded<Sequence> _tail;
+    Padded<Sequence> _head;
+    Cell _cells[SIZE];
+};
+
+
+// Lock-free Single-Producer, Single-Consumer Bounded Queue
+template<typename T, unsigned int SIZE>
+class SPSC_Queue
+{
+private:
+    static const unsigned long MASK = SIZE - 1;
+
+    typedef Atomic<unsigned long> Index;
+
+public:
+    SPSC_Queue(): _tail(0), _head(0) {
+        static_assert((SIZE >= 2) && !(SIZE & MASK), "SPSC_Queue SIZE must be a power of two");
+    }
+
+    bool empty() const { return (_head.load() == _tail.load()); }
+    bool full() const { return (size() == SIZE); }
+    unsigned int size() const { return _tail.load() - _head.load(); }
+
+    // Producer only
+    bool insert(const T & o) {
+        unsigned long tail = _tail.load();
+        if(tail - _head.load_acquire() == SIZE)
+            return false;
+        _objects[tail & MASK] = o;
+        _tail.store_release(tail + 1);
+        return true;
+    }
+
+    // Consumer only
+    bool remove(T * o) {
+        unsigned long head = _head.load();
+        if(head == _tail.load_acquire())
+            return false;
+        *o = _objects[head & MASK];
+        _head.store_release(head + 1);
+        return true;
+    }
+
+private:
+    Padded<Index> _tail;
+    Padded<Index> _head;
+    T _objects[SIZE];
+};
+
 __END_UTIL
 
 #endif
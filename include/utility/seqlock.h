@@ -0,0 +1,48 @@
+// EPOS Sequence Lock Utility Declarations
+
+// Readers never write shared state nor block writers: they take a snapshot of the sequence number, read the
+// protected data and retry if a write overlapped the read (odd or changed sequence). Writers must be
+// serialized by other means (e.g. a Spin) and cannot be preempted by readers on the same core.
+
+#ifndef __seqlock_h
+#define __seqlock_h
+
+#include <architecture/cpu.h>
+
+__BEGIN_UTIL
+
+class Seqlock
+{
+public:
+    Seqlock(): _sequence(0) {}
+
+    void write_begin() {
+        _sequence++;
+        CPU::memory_barrier();
+    }
+
+    void write_end() {
+        CPU::memory_barrier();
+        _sequence++;
+    }
+
+    unsigned long read_begin() const {
+        unsigned long sequence;
+        while((sequence = _sequence) & 1)
+            CPU::pause();
+        CPU::memory_barrier();
+        return sequence;
+    }
+
+    bool read_retry(unsigned long sequence) const {
+        CPU::memory_barrier();
+        return (_sequence != sequence);
+    }
+
+private:
+    volatile unsigned long _sequence;
+};
+
+__END_UTIL
+
+#endif
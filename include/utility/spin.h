@@ -4,6 +4,8 @@
 #define __spin_h
 
 #include <architecture.h>
+#include <utility/atomic.h>
+#include <utility/lock_profiler.h>
 
 extern "C" { volatile unsigned long _running(); }
 
@@ -18,12 +20,23 @@ public:
     void acquire() {
         unsigned long me = _running();
 
-        while(CPU::cas(_owner, 0UL, me) != me);
+        while(CPU::cas(_owner, 0UL, me) != me)
+            while(_owner && (_owner != me)) // test-and-test-and-set: wait on a shared copy of the line
+                CPU::pause();
         _level++;
 
         db<Spin>(TRC) << "Spin::acquire[this=" << this << ",id=" << hex << me << "]() => {owner=" << _owner << dec << ",level=" << _level << "}" << endl;
     }
 
+    bool try_acquire() {
+        unsigned long me = _running();
+        unsigned long owner = CPU::cas(_owner, 0UL, me);
+        if(owner && (owner != me))
+            return false;
+        _level++;
+        return true;
+    }
+
     void release() {
         db<Spin>(TRC) << "Spin::release[this=" << this << "]() => {owner=" << hex << _owner << dec << ",level=" << _level << "}" << endl;
 
@@ -34,6 +47,7 @@ public:
     }
 
     volatile bool taken() const { return (_owner != 0); }
+    long level() const { return _level; }
 
 private:
     volatile long _level;
@@ -47,12 +61,15 @@ public:
     Simple_Spin(): _locked(false) {}
 
     void acquire() {
-        while(CPU::tsl(_locked));
+        while(CPU::tsl(_locked))
+            while(_locked)
+                CPU::pause();
 
         db<Spin>(TRC) << "Spin::acquire[SPIN=" << this << "]()" << endl;
     }
 
     void release() {
+        CPU::memory_barrier(); // keep the critical section inside the lock
         _locked = 0;
 
         db<Spin>(TRC) << "Spin::release[SPIN=" << this << "]()}" << endl;
@@ -62,26 +79,218 @@ private:
     volatile bool _locked;
 };
 
-class Core_Spin: protected Spin
+// FIFO Ticket Spin Lock
+// Grants the lock in arrival order, but all waiters still spin on (and invalidate) the same line
+class Ticket_Spin
 {
+public:
+    Ticket_Spin(): _next(0), _serving(0) {}
+
+    void acquire() {
+        unsigned long ticket = CPU::finc(_next);
+        while(_serving != ticket)
+            CPU::wait_event();
+        CPU::memory_barrier(); // the AMOs have no ordering of their own on some architectures (e.g. RISC-V)
+
+        db<Spin>(TRC) << "Ticket_Spin::acquire[this=" << this << "]() => {ticket=" << ticket << "}" << endl;
+    }
+
+    bool try_acquire() {
+        unsigned long ticket = _serving;
+        return (_next == ticket) && (CPU::cas(_next, ticket, ticket + 1) == ticket);
+    }
+
+    void release() {
+        db<Spin>(TRC) << "Ticket_Spin::release[this=" << this << "]() => {serving=" << _serving << "}" << endl;
+
+        CPU::memory_barrier();
+        CPU::finc(_serving);
+        CPU::signal_event();
+    }
+
+    volatile bool taken() const { return (_next != _serving); }
+
+private:
+    volatile unsigned long _next;
+    volatile unsigned long _serving;
+};
+
+// FIFO MCS (queue) Spin Lock
+// Each waiter spins on its own node, so a release touches a single remote line. Nodes are per core, thus
+// the lock must not be held across a context switch or re-acquired by an interrupt handler on the same core
+// (i.e. it must be held with interrupts disabled, as Core_Spin does).
+class MCS_Spin
+{
+private:
+    struct _Node
+    {
+        _Node * volatile next;
+        volatile bool waiting;
+    };
+    typedef Padded<_Node> Node;
+
+public:
+    MCS_Spin(): _tail(0) {}
+
+    void acquire() {
+        Node * node = &_nodes[CPU::id()];
+        node->next = 0;
+        node->waiting = true;
+
+        Node * prev;
+        do prev = _tail; while(CPU::cas(_tail, prev, node) != prev);
+
+        if(prev) {
+            prev->next = node;
+            while(node->waiting)
+                CPU::wait_event();
+        }
+        CPU::memory_barrier(); // the hand over is a plain store, thus unordered
+
+        db<Spin>(TRC) << "MCS_Spin::acquire[this=" << this << "]() => {prev=" << prev << "}" << endl;
+    }
+
+    bool try_acquire() {
+        Node * node = &_nodes[CPU::id()];
+        node->next = 0;
+        return !_tail && (CPU::cas(_tail, static_cast<Node *>(0), node) == 0);
+    }
+
+    void release() {
+        Node * node = &_nodes[CPU::id()];
+
+        db<Spin>(TRC) << "MCS_Spin::release[this=" << this << "]() => {next=" << node->next << "}" << endl;
+
+        if(!node->next) {
+            if(CPU::cas(_tail, node, static_cast<Node *>(0)) == node)
+                return;
+            while(!node->next) // a successor is between the cas on _tail and linking itself
+                CPU::pause();
+        }
+        CPU::memory_barrier();
+        node->next->waiting = false;
+        CPU::signal_event();
+    }
+
+    volatile bool taken() const { return (_tail != 0); }
+
+private:
+    Node * volatile _tail;
+    Node _nodes[Traits<Build>::CPUS];
+};
+
+// Recursive wrapper for the FIFO locks above
+// Ownership is tracked per core, which is sound because Core_Spin holders run with interrupts disabled.
+// Owners are stored as CPU::id() + 1, so a zero-initialized lock is free even before its constructor runs
+// (static locks, such as Thread::_lock, may be used during INIT before global constructors get to them).
+template<typename Lock>
+class Core_Queued_Spin
+{
+private:
+    static const unsigned int NOBODY = 0;
+
+public:
+    Core_Queued_Spin(): _level(0), _owner(NOBODY) {}
+
+    void acquire() {
+        unsigned int me = CPU::id() + 1;
+        if(_owner != me) {
+            _lock.acquire();
+            _owner = me;
+        }
+        _level++;
+    }
+
+    bool try_acquire() {
+        unsigned int me = CPU::id() + 1;
+        if(_owner != me) {
+            if(!_lock.try_acquire())
+                return false;
+            _owner = me;
+        }
+        _level++;
+        return true;
+    }
+
+    void release() {
+        assert(_owner == CPU::id() + 1); // unbalanced release
+
+        if(--_level <= 0) {
+            _level = 0;
+            _owner = NOBODY;
+            _lock.release();
+        }
+    }
+
+    volatile bool taken() const { return _lock.taken(); }
+    long level() const { return _level; }
+
+private:
+    volatile long _level;
+    volatile unsigned int _owner;
+    Lock _lock;
+};
+
+// Kernel Spin Lock
+// Traits<Spin>::algorithm selects the underlying lock. With CAS, a thread arriving with interrupts enabled
+// waits with them enabled and only disables them to take the lock. The FIFO locks keep interrupts disabled
+// while queued, since a handler on the same core would otherwise queue behind the interrupted waiter.
+// With Traits<Spin>::profiled, outermost acquisitions and releases are accounted in Lock_Profiler.
+class Core_Spin
+{
+private:
+    static const bool queued = (Traits<Spin>::algorithm != Traits<Spin>::CAS);
+    static const bool profiled = Traits<Spin>::profiled;
+
+    typedef IF<Traits<Spin>::algorithm == Traits<Spin>::TICKET, Core_Queued_Spin<Ticket_Spin>,
+            IF<Traits<Spin>::algorithm == Traits<Spin>::MCS, Core_Queued_Spin<MCS_Spin>, Spin>::Result>::Result Lock;
+    typedef Lock_Probe<profiled>::Time_Stamp Time_Stamp;
+
 public:
     Core_Spin() {}
 
     void acquire(bool disable_interruptions = true) {
-        if (disable_interruptions)
-            CPU::int_disable();
+        Time_Stamp start = _probe.start();
+        bool contended = false;
+
+        if(disable_interruptions && !queued && CPU::int_enabled()) {
+            for(CPU::int_disable(); !_lock.try_acquire(); CPU::int_disable()) {
+                contended = true;
+                CPU::int_enable();
+                while(_lock.taken())
+                    CPU::pause();
+            }
+        } else {
+            if(disable_interruptions)
+                CPU::int_disable();
 
-        Spin::acquire();
+            if(profiled) {
+                contended = !_lock.try_acquire();
+                if(contended)
+                    _lock.acquire();
+            } else
+                _lock.acquire();
+        }
+
+        if(profiled && (_lock.level() == 1))
+            _probe.acquired(this, start, contended, __builtin_return_address(0));
     }
 
     void release(bool enable_interruptions = true) {
-        Spin::release();
+        if(profiled && (_lock.level() == 1))
+            _probe.released();
+
+        _lock.release();
 
-        if (enable_interruptions)
+        if(enable_interruptions)
             CPU::int_enable();
     }
 
-    volatile bool taken() const { return Spin::taken(); }
+    volatile bool taken() const { return _lock.taken(); }
+
+private:
+    Lock _lock;
+    Lock_Probe<profiled> _probe;
 };
 
 __END_UTIL
@@ -0,0 +1,104 @@
+// EPOS Lock-free Stack Utility Declarations
+
+// Lock_Free_Stack is a bounded Treiber stack of SIZE objects, copied in and out
+// by value. Nodes live in an internal array and are linked by index, so both the
+// stack and its list of free nodes can be represented by a single word holding a
+// node index and a modification tag. Every successful push or pop increments the
+// tag, which defeats the ABA problem without double-word CAS.
+// Index_Stack is the underlying stack of indexes (0 .. SIZE - 1), useful by itself
+// to manage free lists of preallocated objects.
+
+#ifndef __stack_h
+#define __stack_h
+
+#include "atomic.h"
+
+__BEGIN_UTIL
+
+template<unsigned int SIZE>
+class Index_Stack
+{
+public:
+    static const unsigned int NIL = -1U;
+
+private:
+    typedef unsigned long Word;
+
+    static const unsigned int INDEX_BITS = sizeof(Word) * 8 / 2;
+    static const Word INDEX_MASK = (Word(1) << INDEX_BITS) - 1;
+
+public:
+    Index_Stack(bool full = false): _top(pack(0, full ? 0 : NIL)) {
+        static_assert(SIZE < INDEX_MASK, "Index_Stack SIZE too large for the word size");
+        for(unsigned int i = 0; i < SIZE; i++)
+            _next[i] = (full && (i < SIZE - 1)) ? i + 1 : NIL;
+    }
+
+    bool empty() const { return (index(_top.load()) == NIL); }
+
+    void push(unsigned int i) {
+        Word top;
+        do {
+            top = _top.load();
+            _next[i] = index(top);
+        } while(!_top.compare_and_swap(top, pack(tag(top) + 1, i)));
+    }
+
+    unsigned int pop() {
+        Word top;
+        unsigned int i;
+        do {
+            top = _top.load();
+            i = index(top);
+            if(i == NIL)
+                return NIL;
+        } while(!_top.compare_and_swap(top, pack(tag(top) + 1, _next[i]))); // a stale _next[i] fails on the tag
+        return i;
+    }
+
+private:
+    static Word pack(Word tag, unsigned int i) { return (tag << INDEX_BITS) | (Word(i) & INDEX_MASK); }
+    static Word tag(Word w) { return w >> INDEX_BITS; }
+    static unsigned int index(Word w) { Word i = w & INDEX_MASK; return (i == INDEX_MASK) ? NIL : i; }
+
+private:
+    Atomic<Word> _top;
+    volatile unsigned int _next[SIZE];
+};
+
+
+template<typename T, unsigned int SIZE>
+class Lock_Free_Stack
+{
+public:
+    Lock_Free_Stack(): _used(false), _free(true) {}
+
+    bool empty() const { return _used.empty(); }
+
+    bool push(const T & o) {
+        unsigned int i = _free.pop();
+        if(i == Index_Stack<SIZE>::NIL)
+            return false; // full
+        _objects[i] = o;
+        _used.push(i);
+        return true;
+    }
+
+    bool pop(T * o) {
+        unsigned int i = _used.pop();
+        if(i == Index_Stack<SIZE>::NIL)
+            return false; // empty
+        *o = _objects[i];
+        _free.push(i);
+        return true;
+    }
+
+private:
+    Index_Stack<SIZE> _used;
+    Index_Stack<SIZE> _free;
+    T _objects[SIZE];
+};
+
+__END_UTIL
+
+#endif
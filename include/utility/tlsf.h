@@ -0,0 +1,158 @@
+// EPOS TLSF (Two-Level Segregated Fit) Allocator Utility Declarations
+
+// Free blocks are segregated by size in a two-level table of lists (a power-of-two first level split into
+// SL_COUNT linear ranges), each level summarized by a bitmap, so finding a suitable block, splitting it and
+// merging freed blocks with their physical neighbors (through boundary tags) are all O(1).
+// Based on M. Masmano et al., "TLSF: a New Dynamic Memory Allocator for Real-Time Systems" (ECRTS 2004).
+// This is an allocation engine only; locking and the typed-heap header are handled by Heap.
+
+#ifndef __tlsf_h
+#define __tlsf_h
+
+#include <system/config.h>
+
+__BEGIN_UTIL
+
+class TLSF
+{
+private:
+    static const unsigned int ALIGN_LOG2 = (sizeof(void *) == 8) ? 3 : 2;
+    static const unsigned long ALIGN = 1UL << ALIGN_LOG2;
+
+    static const unsigned int SL_LOG2 = 4;
+    static const unsigned int SL_COUNT = 1 << SL_LOG2;
+    static const unsigned int FL_SHIFT = SL_LOG2 + ALIGN_LOG2;
+    static const unsigned int FL_MAX = (sizeof(void *) == 8) ? 32 : 30;
+    static const unsigned int FL_COUNT = FL_MAX - FL_SHIFT + 1;
+    static const unsigned long SMALL_BLOCK = 1UL << FL_SHIFT;
+
+    // As in the reference implementation, "prev" is stored in the last word of the previous block's payload
+    // and is only valid while that block is free; "next_free" and "prev_free" only exist in free blocks.
+    // "size" is the payload size (from next_free on), with the two lowest bits used as flags.
+    struct Block
+    {
+        Block * prev;
+        unsigned long size;
+        Block * next_free;
+        Block * prev_free;
+    };
+
+    enum : unsigned long {
+        FREE            = 1 << 0,
+        PREV_FREE       = 1 << 1,
+        FLAGS           = FREE | PREV_FREE
+    };
+
+    static const unsigned long OVERHEAD = sizeof(unsigned long);                 // of a used block
+    static const unsigned long PAYLOAD = sizeof(Block *) + sizeof(unsigned long); // offset of next_free
+    static const unsigned long MIN_BLOCK = sizeof(Block) - sizeof(Block *);
+    static const unsigned long MAX_BLOCK = 1UL << FL_MAX;
+
+    static const unsigned long POOL_OVERHEAD = 2 * OVERHEAD;
+
+public:
+    TLSF(): _fl_bitmap(0), _free_blocks(0), _free_bytes(0) {
+        _null.prev = 0;
+        _null.size = 0;
+        _null.next_free = &_null;
+        _null.prev_free = &_null;
+        for(unsigned int i = 0; i < FL_COUNT; i++) {
+            _sl_bitmap[i] = 0;
+            for(unsigned int j = 0; j < SL_COUNT; j++)
+                _blocks[i][j] = &_null;
+        }
+    }
+
+    bool empty() const { return !_free_blocks; }
+    unsigned long size() const { return _free_blocks; }
+    unsigned long grouped_size() const { return _free_bytes; }
+
+    // Size of the largest free block (only the highest non-empty list is searched)
+    unsigned long largest() const;
+
+    void * alloc(unsigned long bytes);
+    void free(void * ptr, unsigned long bytes = 0);
+
+    // Allocates a block whose address plus "offset" is a multiple of "align" (a power of two); the gap before it
+    // is split off and given back as a free block, so only gaps too small to be blocks themselves are ever skipped
+    void * alloc_aligned(unsigned long * bytes, unsigned long align, unsigned long offset = 0);
+
+    // Grows the block at "ptr" to "bytes" in place, by taking (part of) the free block right after it
+    bool grow(void * ptr, unsigned long old_bytes, unsigned long bytes);
+
+    // Adds a memory region (pool) to the heap
+    void add(void * ptr, unsigned long bytes);
+
+    // Takes the free memory at the end of the pool that ends at "end" off it, in multiples of "unit" bytes
+    unsigned long trim(void * end, unsigned long unit);
+
+private:
+    static unsigned long align_up(unsigned long x) { return (x + (ALIGN - 1)) & ~(ALIGN - 1); }
+    static unsigned long align_down(unsigned long x) { return x & ~(ALIGN - 1); }
+
+    // Find first/last set bit (0-based)
+    static unsigned int ffs(unsigned int word) { return __builtin_ctz(word); }
+    static unsigned int fls(unsigned long word) { return (sizeof(unsigned long) * 8 - 1) - __builtin_clzl(word); }
+
+    // Block operations
+    static unsigned long block_size(const Block * b) { return b->size & ~FLAGS; }
+    static void block_size(Block * b, unsigned long s) { b->size = s | (b->size & FLAGS); }
+
+    static bool is_free(const Block * b) { return b->size & FREE; }
+    static void set_free(Block * b) { b->size |= FREE; }
+    static void set_used(Block * b) { b->size &= ~FREE; }
+    static bool is_prev_free(const Block * b) { return b->size & PREV_FREE; }
+    static void set_prev_free(Block * b) { b->size |= PREV_FREE; }
+    static void set_prev_used(Block * b) { b->size &= ~PREV_FREE; }
+
+    static Block * from_ptr(void * p) { return reinterpret_cast<Block *>(reinterpret_cast<char *>(p) - PAYLOAD); }
+    static void * to_ptr(Block * b) { return reinterpret_cast<char *>(b) + PAYLOAD; }
+    static Block * offset(void * p, long bytes) { return reinterpret_cast<Block *>(reinterpret_cast<char *>(p) + bytes); }
+
+    static Block * next(Block * b) { return offset(to_ptr(b), block_size(b) - OVERHEAD); }
+    static Block * link_next(Block * b) { Block * n = next(b); n->prev = b; return n; }
+
+    static void mark_as_free(Block * b) { Block * n = link_next(b); set_prev_free(n); set_free(b); }
+    static void mark_as_used(Block * b) { Block * n = next(b); set_prev_used(n); set_used(b); }
+
+    // Size to list mapping
+    static void mapping_insert(unsigned long s, unsigned int * fl, unsigned int * sl) {
+        if(s < SMALL_BLOCK) {
+            *fl = 0;
+            *sl = s / (SMALL_BLOCK / SL_COUNT);
+        } else {
+            unsigned int f = fls(s);
+            *sl = (s >> (f - SL_LOG2)) ^ (1 << SL_LOG2);
+            *fl = f - (FL_SHIFT - 1);
+        }
+    }
+
+    // Rounds up to the next list, so any block found there fits
+    static void mapping_search(unsigned long s, unsigned int * fl, unsigned int * sl) {
+        if(s >= SMALL_BLOCK)
+            s += (1UL << (fls(s) - SL_LOG2)) - 1;
+        mapping_insert(s, fl, sl);
+    }
+
+    Block * search_suitable(unsigned int * fl, unsigned int * sl);
+
+    void remove(Block * b, unsigned int fl, unsigned int sl);
+    void insert(Block * b, unsigned int fl, unsigned int sl);
+    void remove(Block * b) { unsigned int fl, sl; mapping_insert(block_size(b), &fl, &sl); remove(b, fl, sl); }
+    void insert(Block * b) { unsigned int fl, sl; mapping_insert(block_size(b), &fl, &sl); insert(b, fl, sl); }
+
+    Block * split(Block * b, unsigned long s);
+    Block * absorb(Block * prev, Block * b);
+
+private:
+    unsigned int _fl_bitmap;
+    unsigned int _sl_bitmap[FL_COUNT];
+    Block * _blocks[FL_COUNT][SL_COUNT];
+    Block _null;
+    unsigned long _free_blocks;
+    unsigned long _free_bytes;
+};
+
+__END_UTIL
+
+#endif
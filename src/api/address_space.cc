@@ -51,6 +51,13 @@ void Address_Space::detach(Segment * seg, Log_Addr addr)
     Directory::detach(*seg, addr);
 }
 
+long Address_Space::resize(Segment * seg, Log_Addr addr, long amount)
+{
+    db<Address_Space>(TRC) << "Address_Space::resize(this=" << this << ",seg=" << seg << ",addr=" << addr << ",amount=" << amount << ")" << endl;
+
+    return Directory::resize(*seg, addr, amount);
+}
+
 Address_Space::Phy_Addr Address_Space::physical(Log_Addr address)
 {
     return Directory::physical(address);
@@ -4,11 +4,14 @@
 #include <synchronizer.h>
 #include <time.h>
 #include <process.h>
+#include <system.h>
 
 __BEGIN_SYS
 
 Alarm_Timer * Alarm::_timer;
 volatile Alarm::Tick Alarm::_elapsed;
+volatile TSC::Time_Stamp Alarm::_stamp;
+Seqlock Alarm::_time_base;
 Alarm::Queue Alarm::_request;
 Core_Spin Alarm::_lock;
 
@@ -31,6 +34,11 @@ Alarm::Alarm(Microsecond time, Handler * handler, unsigned int times)
     Task::self()->enroll(this);
 }
 
+void * Alarm::operator new(size_t bytes, const System_Allocator & allocator)
+{
+    return Object_Cache<Alarm>::alloc(bytes);
+}
+
 Alarm::~Alarm()
 {
     lock();
@@ -89,11 +97,43 @@ void Alarm::delay(Microsecond time)
 }
 
 
+// Time since boot, interpolated between ticks with the TSC
+// The interpolation is clamped to a tick period, so now() never goes backwards when the next tick is accounted.
+Microsecond Alarm::now()
+{
+    Tick elapsed;
+    TSC::Time_Stamp stamp, current;
+    unsigned long sequence;
+    do {
+        sequence = _time_base.read_begin();
+        elapsed = _elapsed;
+        stamp = _stamp;
+        current = Traits<TSC>::enabled ? TSC::time_stamp() : stamp;
+    } while(_time_base.read_retry(sequence));
+
+    Time_Base time = Timer_Common::time(elapsed, frequency());
+
+    if(Traits<TSC>::enabled) {
+        TSC::Time_Stamp per_tick = TSC::frequency() / frequency();
+        TSC::Time_Stamp delta = current - stamp;
+        if(delta >= per_tick)
+            delta = per_tick - 1;
+        time += Time_Base(delta * 1000000 / TSC::frequency());
+    }
+
+    return time;
+}
+
+
 void Alarm::handler(IC::Interrupt_Id i)
 {
     lock();
 
+    _time_base.write_begin();
     _elapsed++;
+    if(Traits<TSC>::enabled)
+        _stamp = TSC::time_stamp();
+    _time_base.write_end();
 
     if(Traits<Alarm>::visible) {
         Display display;
@@ -10,6 +10,9 @@ void Alarm::init()
     db<Init, Alarm>(TRC) << "Alarm::init()" << endl;
 
     _timer = new (SYSTEM) Alarm_Timer(handler);
+
+    if(Traits<TSC>::enabled)
+        _stamp = TSC::time_stamp();
 }
 
 __END_SYS
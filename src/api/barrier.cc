@@ -0,0 +1,103 @@
+// EPOS Barrier and Latch Implementation
+
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+Barrier::Barrier(unsigned int count): Synchronizer_Common(false), _count(count), _arrived(0), _sense(false)
+{
+    db<Synchronizer>(TRC) << "Barrier(count=" << count << ") => " << this << endl;
+
+    Task::self()->enroll(this);
+}
+
+
+Barrier::~Barrier()
+{
+    db<Synchronizer>(TRC) << "~Barrier(this=" << this << ")" << endl;
+
+    Task::self()->dismiss(this);
+}
+
+
+bool Barrier::wait()
+{
+    db<Synchronizer>(TRC) << "Barrier::wait(this=" << this << ",arrived=" << _arrived << ")" << endl;
+
+    bool sense = _sense;
+
+    if(finc(_arrived) == long(_count) - 1) {
+        _arrived = 0; // before releasing anyone, so the next phase starts from scratch
+        CPU::memory_barrier(); // Thread::lock() need not order the reset before the flip of _sense below
+        begin_atomic();
+        _sense = !sense;
+        wakeup_all();
+        end_atomic();
+        return true;
+    }
+
+    for(unsigned int i = 0; i < SPINS; i++) {
+        if(_sense != sense)
+            return false;
+        CPU::pause();
+    }
+
+    begin_atomic();
+    if(_sense == sense)
+        sleep();
+    end_atomic();
+
+    return false;
+}
+
+
+Latch::Latch(unsigned int count): Synchronizer_Common(false), _count(count)
+{
+    db<Synchronizer>(TRC) << "Latch(count=" << count << ") => " << this << endl;
+
+    Task::self()->enroll(this);
+}
+
+
+Latch::~Latch()
+{
+    db<Synchronizer>(TRC) << "~Latch(this=" << this << ")" << endl;
+
+    Task::self()->dismiss(this);
+}
+
+
+void Latch::count_down(unsigned int n)
+{
+    db<Synchronizer>(TRC) << "Latch::count_down(this=" << this << ",count=" << _count << ",n=" << n << ")" << endl;
+
+    if(!n)
+        return;
+
+    long count;
+    do
+        count = _count;
+    while(cas(_count, count, count - n) != count);
+
+    if((count > 0) && (count <= long(n))) { // this call is the one that took the count to zero (or below)
+        begin_atomic();
+        wakeup_all();
+        end_atomic();
+    }
+}
+
+
+void Latch::wait()
+{
+    db<Synchronizer>(TRC) << "Latch::wait(this=" << this << ",count=" << _count << ")" << endl;
+
+    if(_count <= 0)
+        return;
+
+    begin_atomic();
+    while(_count > 0)
+        sleep();
+    end_atomic();
+}
+
+__END_SYS
@@ -0,0 +1,197 @@
+// EPOS Message Channel Implementation
+
+#include <synchronizer.h>
+#include <time.h>
+
+__BEGIN_SYS
+
+Channel::Channel(void ** ring, unsigned int size)
+: Synchronizer_Common(false), _ring(ring), _size(size), _head(0), _count(0), _promised(0), _reserved(0), _selecting(0)
+{
+    db<Synchronizer>(TRC) << "Channel(size=" << size << ") => " << this << endl;
+
+    Task::self()->enroll(this);
+}
+
+
+Channel::~Channel()
+{
+    db<Synchronizer>(TRC) << "~Channel(this=" << this << ")" << endl;
+
+    begin_atomic();
+    if(!_senders.empty())
+        db<Synchronizer>(WRN) << "~Channel(this=" << this << ") called with active blocked senders!" << endl;
+    wakeup_all(&_senders);
+    end_atomic();
+
+    Task::self()->dismiss(this);
+}
+
+
+bool Channel::send(void * message, const Microsecond & time)
+{
+    db<Synchronizer>(TRC) << "Channel::send(this=" << this << ",msg=" << message << ",timeout=" << time << ",count=" << _count << ")" << endl;
+
+    if((Time_Base(time) == INFINITE) || (Time_Base(time) == 0))
+        return send(message, Time_Base(time) != 0, 0);
+
+    Timeout_Handler<Channel> handler(this, running());
+    Alarm alarm(time, &handler, 1); // if time < tick, the handler fires right away
+    return send(message, true, &handler);
+}
+
+
+void * Channel::receive(const Microsecond & time)
+{
+    db<Synchronizer>(TRC) << "Channel::receive(this=" << this << ",timeout=" << time << ",count=" << _count << ")" << endl;
+
+    if((Time_Base(time) == INFINITE) || (Time_Base(time) == 0))
+        return receive(Time_Base(time) != 0, 0);
+
+    Timeout_Handler<Channel> handler(this, running());
+    Alarm alarm(time, &handler, 1); // if time < tick, the handler fires right away
+    return receive(true, &handler);
+}
+
+
+int Channel::select(Channel * const channels[], unsigned int n, const Microsecond & time)
+{
+    db<Synchronizer>(TRC) << "Channel::select(n=" << n << ",timeout=" << time << ")" << endl;
+
+    if(!n)
+        return -1;
+
+    if((Time_Base(time) == INFINITE) || (Time_Base(time) == 0))
+        return select(channels, n, Time_Base(time) != 0, 0);
+
+    Timeout_Handler<Channel> handler(channels[0], channels[0]->running());
+    Alarm alarm(time, &handler, 1); // if time < tick, the handler fires right away
+    return select(channels, n, true, &handler);
+}
+
+
+// Blocks while the channel is full if "wait", until "handler" (if any) expires
+bool Channel::send(void * message, bool wait, Timeout_Handler<Channel> * handler)
+{
+    begin_atomic();
+    if(!room()) {
+        if(!wait || (handler && handler->fired())) {
+            end_atomic();
+            return false;
+        }
+        sleep(&_senders);
+        if(handler && handler->expired()) {
+            end_atomic();
+            return false;
+        }
+        _reserved--; // the receiver that woke us up reserved a slot
+    }
+
+    put(message);
+
+    if(!_waiting.empty()) {
+        _promised++;
+        wakeup(); // the message goes to the first receiver waiting
+    } else if(_selecting)
+        wakeup_all(_selecting);
+    end_atomic();
+
+    return true;
+}
+
+
+// Blocks while the channel is empty if "wait", until "handler" (if any) expires
+void * Channel::receive(bool wait, Timeout_Handler<Channel> * handler)
+{
+    begin_atomic();
+    if(!available()) {
+        if(!wait || (handler && handler->fired())) {
+            end_atomic();
+            return 0;
+        }
+        sleep();
+        if(handler && handler->expired()) {
+            end_atomic();
+            return 0;
+        }
+        _promised--; // the sender that woke us up promised us a message
+    }
+
+    void * message = get();
+
+    if(!_senders.empty()) {
+        _reserved++;
+        wakeup(&_senders); // the slot goes to the first sender waiting
+    }
+    end_atomic();
+
+    return message;
+}
+
+
+// Blocks while all channels are empty if "wait", until "handler" (if any) expires
+int Channel::select(Channel * const channels[], unsigned int n, bool wait, Timeout_Handler<Channel> * handler)
+{
+    Thread_Queue selecting;
+    int ready = -1;
+
+    channels[0]->begin_atomic();
+    for(;;) {
+        for(unsigned int i = 0; i < n; i++)
+            if(channels[i]->available()) {
+                ready = i;
+                break;
+            }
+        if((ready >= 0) || !wait || (handler && handler->fired()))
+            break;
+
+        for(unsigned int i = 0; i < n; i++)
+            channels[i]->_selecting = &selecting;
+        channels[0]->sleep(&selecting);
+        for(unsigned int i = 0; i < n; i++)
+            if(channels[i]->_selecting == &selecting)
+                channels[i]->_selecting = 0;
+    }
+    channels[0]->end_atomic();
+
+    return ready;
+}
+
+
+void Channel::put(void * message)
+{
+    unsigned int tail = _head + _count;
+    if(tail >= _size)
+        tail -= _size;
+    _ring[tail] = message;
+    _count++;
+}
+
+
+void * Channel::get()
+{
+    void * message = _ring[_head];
+    if(++_head == _size)
+        _head = 0;
+    _count--;
+    return message;
+}
+
+
+// Called by Timeout_Handler; returns whether "t" was still waiting (kernel locked by us)
+bool Channel::timeout(Thread * t)
+{
+    bool expired = false;
+
+    begin_atomic();
+    if(waiting(t) || waiting(t, &_senders) || (_selecting && waiting(t, _selecting))) {
+        db<Synchronizer>(TRC) << "Channel::timeout(this=" << this << ",t=" << t << ")" << endl;
+        wakeup(t);
+        expired = true;
+    }
+    end_atomic();
+
+    return expired;
+}
+
+__END_SYS
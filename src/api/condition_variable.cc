@@ -0,0 +1,111 @@
+// EPOS Monitor-style Condition Variable Implementation
+
+#include <synchronizer.h>
+#include <time.h>
+
+__BEGIN_SYS
+
+Condition_Variable::Condition_Variable(bool priority_inversion): Synchronizer_Common(priority_inversion), _mutex(0)
+{
+    db<Synchronizer>(TRC) << "Condition_Variable() => " << this << endl;
+
+    Task::self()->enroll(this);
+}
+
+
+Condition_Variable::~Condition_Variable()
+{
+    db<Synchronizer>(TRC) << "~Condition_Variable(this=" << this << ")" << endl;
+
+    Task::self()->dismiss(this);
+}
+
+
+void Condition_Variable::wait(Mutex & mutex)
+{
+    db<Synchronizer>(TRC) << "Condition_Variable::wait(this=" << this << ",mutex=" << &mutex << ")" << endl;
+
+    begin_atomic();
+    _mutex = &mutex;
+    mutex.revoke();
+    mutex.release();
+    sleep(); // returns with the mutex handed over to us by transfer() or by Mutex::release()
+    mutex._owner = running();
+    mutex.grant();
+    end_atomic();
+}
+
+
+bool Condition_Variable::wait(Mutex & mutex, const Microsecond & time)
+{
+    db<Synchronizer>(TRC) << "Condition_Variable::wait(this=" << this << ",mutex=" << &mutex << ",timeout=" << time << ")" << endl;
+
+    Timeout_Handler<Condition_Variable> handler(this, running());
+    Alarm alarm(time, &handler, 1); // if time < tick, the handler fires right away
+
+    begin_atomic();
+    if(handler.fired()) { // expired before we could even wait, so we still hold the mutex
+        end_atomic();
+        return false;
+    }
+    _mutex = &mutex;
+    mutex.revoke();
+    mutex.release();
+    sleep();
+    mutex._owner = running();
+    mutex.grant();
+    end_atomic();
+
+    return !handler.expired();
+}
+
+
+void Condition_Variable::signal()
+{
+    db<Synchronizer>(TRC) << "Condition_Variable::signal(this=" << this << ")" << endl;
+
+    begin_atomic();
+    if(!_waiting.empty())
+        transfer(_waiting.head()->object());
+    end_atomic();
+}
+
+
+void Condition_Variable::broadcast()
+{
+    db<Synchronizer>(TRC) << "Condition_Variable::broadcast(this=" << this << ")" << endl;
+
+    begin_atomic();
+    while(!_waiting.empty())
+        transfer(_waiting.head()->object()); // at most one gets the mutex, the others wait for it at the mutex
+    end_atomic();
+}
+
+
+// Hands the mutex over to a waiting thread if it is free, otherwise moves the thread to the mutex's queue (kernel locked)
+void Condition_Variable::transfer(Thread * t)
+{
+    if(!_mutex->tsl(_mutex->_locked))
+        wakeup(t);
+    else
+        requeue(t, _mutex->waiting());
+}
+
+
+// Called by Timeout_Handler; returns whether "t" was still waiting
+bool Condition_Variable::timeout(Thread * t)
+{
+    bool expired = false;
+
+    begin_atomic();
+    if(waiting(t)) {
+        db<Synchronizer>(TRC) << "Condition_Variable::timeout(this=" << this << ",t=" << t << ")" << endl;
+        transfer(t);
+        expired = true;
+    }
+    end_atomic();
+
+    return expired;
+}
+
+__END_SYS
@@ -4,7 +4,7 @@
 
 __BEGIN_SYS
 
-Mutex::Mutex(bool priority_inversion): Synchronizer_Common(priority_inversion), _locked(0)
+Mutex::Mutex(bool priority_inversion): Synchronizer_Common(priority_inversion), _locked(0), _owner(0), _spins(0)
 {
     db<Synchronizer>(TRC) << "Mutex() => " << this << endl;
 
@@ -24,9 +24,17 @@ void Mutex::lock()
 {
     db<Synchronizer>(TRC) << "Mutex::lock(this=" << this << ")" << endl;
 
+    if(adaptive && spin()) {
+        lock_for_acquiring();
+        _owner = running();
+        unlock_for_acquiring();
+        return;
+    }
+
     lock_for_acquiring();
     if(tsl(_locked))
         sleep();
+    _owner = running();
     unlock_for_acquiring();
 }
 
@@ -36,11 +44,55 @@ void Mutex::unlock()
     db<Synchronizer>(TRC) << "Mutex::unlock(this=" << this << ")" << endl;
 
     lock_for_releasing();
+    release();
+    unlock_for_releasing();
+}
+
+
+void Mutex::release()
+{
+    _owner = 0;
     if(_waiting.empty())
         asz(_locked);
     else
-        wakeup();
-    unlock_for_releasing();
+        wakeup(); // ownership is handed over to the first waiter
+}
+
+
+// Spins on the lock for as long as its owner is running on another CPU, but no longer
+// than twice the average number of spins that succeeded in the past (bounded by MAX_SPINS).
+// Failed spins only decay the average, so it never grows under contention that spinning does not solve.
+// Succeeding here saves a context switch on this CPU and an IPI to wake us up later.
+bool Mutex::spin()
+{
+    Thread * me = running();
+    long limit = 2 * _spins + 10;
+    if(limit > long(MAX_SPINS))
+        limit = MAX_SPINS;
+
+    bool acquired = false;
+    long i;
+    for(i = 0; i < limit; i++) {
+        if(!_locked && !tsl(_locked)) {
+            acquired = true;
+            break;
+        }
+
+        Thread * owner = _owner;
+        if(owner && ((owner == me) || (owner->state() != Thread::RUNNING)))
+            break;
+
+        CPU::pause();
+    }
+
+    if(acquired)
+        _spins += (i - long(_spins)) / 8;
+    else
+        _spins -= _spins / 8;
+
+    db<Synchronizer>(TRC) << "Mutex::spin(this=" << this << ",spins=" << i << ",avg=" << _spins << ") => " << acquired << endl;
+
+    return acquired;
 }
 
 __END_SYS
@@ -0,0 +1,116 @@
+// EPOS Readers-Writer Lock Implementation
+
+#include <synchronizer.h>
+
+__BEGIN_SYS
+
+RW_Lock::RW_Lock(bool writer_preference, bool priority_inversion)
+: Synchronizer_Common(priority_inversion), _state(0), _writers(0), _writer_preference(writer_preference)
+{
+    db<Synchronizer>(TRC) << "RW_Lock(wp=" << writer_preference << ") => " << this << endl;
+
+    Task::self()->enroll(this);
+}
+
+
+RW_Lock::~RW_Lock()
+{
+    db<Synchronizer>(TRC) << "~RW_Lock(this=" << this << ")" << endl;
+
+    begin_atomic();
+    if(!_readers.empty())
+        db<Synchronizer>(WRN) << "~RW_Lock(this=" << this << ") called with active blocked readers!" << endl;
+    wakeup_all(&_readers);
+    end_atomic();
+
+    Task::self()->dismiss(this);
+}
+
+
+void RW_Lock::lock_read()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::lock_read(this=" << this << ",state=" << _state << ")" << endl;
+
+    if(tracked()) {
+        lock_for_acquiring();
+        if(!try_read())
+            sleep(&_readers); // the releasing writer accounts for us in _state
+        unlock_for_acquiring();
+    } else if(!try_read()) {
+        begin_atomic();
+        if(!try_read())
+            sleep(&_readers);
+        end_atomic();
+    }
+}
+
+
+void RW_Lock::unlock_read()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::unlock_read(this=" << this << ",state=" << _state << ")" << endl;
+
+    if(tracked()) {
+        lock_for_releasing();
+        if((fdec(_state) == 1) && _writers)
+            hand_over_to_writer();
+        unlock_for_releasing();
+    } else if((fdec(_state) == 1) && _writers) {
+        begin_atomic();
+        hand_over_to_writer();
+        end_atomic();
+    }
+}
+
+
+void RW_Lock::lock_write()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::lock_write(this=" << this << ",state=" << _state << ")" << endl;
+
+    lock_for_acquiring();
+    _writers++; // must be visible before trying, so the last reader leaving won't miss us
+    if(cas(_state, 0, WRITER) == 0)
+        _writers--;
+    else
+        sleep(); // the releaser leaves _state = WRITER for us
+    unlock_for_acquiring();
+}
+
+
+void RW_Lock::unlock_write()
+{
+    db<Synchronizer>(TRC) << "RW_Lock::unlock_write(this=" << this << ",state=" << _state << ")" << endl;
+
+    lock_for_releasing();
+    if(_writers && (_writer_preference || _readers.empty())) {
+        _writers--;
+        wakeup();
+    } else if(!_readers.empty()) {
+        cas(_state, WRITER, _readers.size());
+        wakeup_all(&_readers);
+    } else
+        asz(_state);
+    unlock_for_releasing();
+}
+
+
+// Readers get in as long as there is no writer holding the lock or, with writer preference, waiting for it
+bool RW_Lock::try_read()
+{
+    for(long s = _state; (s != WRITER) && !(_writer_preference && _writers); s = _state)
+        if(cas(_state, s, s + 1) == s)
+            return true;
+
+    return false;
+}
+
+
+// Called with the kernel locked by the last reader to leave
+void RW_Lock::hand_over_to_writer()
+{
+    if(_writers && (cas(_state, 0, WRITER) == 0)) {
+        _writers--;
+        wakeup();
+    }
+}
+
+__END_SYS
@@ -6,15 +6,24 @@
 __BEGIN_SYS
 
 // Methods
-Segment::Segment(unsigned long bytes, Flags flags): Chunk(bytes, flags, WHITE)
+Segment::Segment(unsigned long bytes, Flags flags, Color color): Chunk(bytes, flags, color)
 {
-    db<Segment>(TRC) << "Segment(bytes=" << bytes << ",flags=" << flags << ") [Chunk::pt=" << Chunk::pt() << ",sz=" << Chunk::size() << "] => " << this << endl;
+    db<Segment>(TRC) << "Segment(bytes=" << bytes << ",flags=" << flags << ",color=" << color << ") [Chunk::pt=" << Chunk::pt() << ",sz=" << Chunk::size() << "] => " << this << endl;
 
     if(Task::self()) // segments can be created at boot-time, before Task::init()
         Task::self()->enroll(this);
 }
 
 
+Segment::Segment(Segment * seg, Flags flags): Chunk(*seg, flags)
+{
+    db<Segment>(TRC) << "Segment(seg=" << seg << ",flags=" << flags << ") [Chunk::pt=" << Chunk::pt() << ",sz=" << Chunk::size() << "] => " << this << endl;
+
+    if(Task::self())
+        Task::self()->enroll(this);
+}
+
+
 Segment::Segment(Phy_Addr phy_addr, unsigned long bytes, Flags flags): Chunk(phy_addr, bytes, flags | Flags::IO)
 // The MMU::IO flag signalizes the MMU that the attached memory shall not be released when the chunk is deleted
 {
@@ -43,11 +52,11 @@ Segment::Phy_Addr Segment::phy_address() const
 }
 
 
-long Segment::resize(long amount)
+long Segment::resize(long amount, Color color)
 {
-    db<Segment>(TRC) << "Segment::resize(amount=" << amount << ")" << endl;
+    db<Segment>(TRC) << "Segment::resize(amount=" << amount << ",color=" << color << ")" << endl;
 
-    return Chunk::resize(amount);
+    return Chunk::resize(amount, color);
 }
 
 
@@ -1,6 +1,7 @@
 // EPOS Semaphore Implementation
 
 #include <synchronizer.h>
+#include <system.h>
 
 __BEGIN_SYS
 
@@ -12,6 +13,12 @@ Semaphore::Semaphore(long v, bool priority_inversion) : Synchronizer_Common(prio
 }
 
 
+void * Semaphore::operator new(size_t bytes, const System_Allocator & allocator)
+{
+    return Object_Cache<Semaphore>::alloc(bytes);
+}
+
+
 Semaphore::~Semaphore()
 {
     db<Synchronizer>(TRC) << "~Semaphore(this=" << this << ")" << endl;
@@ -28,10 +28,30 @@ Task::~Task()
             db<Task>(INF) << "~Task: deleting Semaphore " << r->object() << "!" << endl;
             delete reinterpret_cast<Semaphore *>(r->object());
             break;
+        case Type<RW_Lock>::ID:
+            db<Task>(INF) << "~Task: deleting RW_Lock " << r->object() << "!" << endl;
+            delete reinterpret_cast<RW_Lock *>(r->object());
+            break;
         case Type<Condition>::ID:
             db<Task>(INF) << "~Task: deleting Condition " << r->object() << "!" << endl;
             delete reinterpret_cast<Condition *>(r->object());
             break;
+        case Type<Condition_Variable>::ID:
+            db<Task>(INF) << "~Task: deleting Condition_Variable " << r->object() << "!" << endl;
+            delete reinterpret_cast<Condition_Variable *>(r->object());
+            break;
+        case Type<Barrier>::ID:
+            db<Task>(INF) << "~Task: deleting Barrier " << r->object() << "!" << endl;
+            delete reinterpret_cast<Barrier *>(r->object());
+            break;
+        case Type<Latch>::ID:
+            db<Task>(INF) << "~Task: deleting Latch " << r->object() << "!" << endl;
+            delete reinterpret_cast<Latch *>(r->object());
+            break;
+        case Type<Channel>::ID:
+            db<Task>(INF) << "~Task: deleting Channel " << r->object() << "!" << endl;
+            delete reinterpret_cast<Channel *>(r->object());
+            break;
         case Type<Alarm>::ID:
             db<Task>(INF) << "~Task: deleting Alarm " << r->object() << "!" << endl;
             delete reinterpret_cast<Alarm *>(r->object());
@@ -19,14 +19,34 @@ Scheduler<Thread> Thread::_scheduler;
 Core_Spin Thread::_lock;
 
 
-void Thread::constructor_prologue(unsigned int stack_size)
+void Thread::constructor_prologue(unsigned int stack_size, Color color)
 {
     lock();
 
     _thread_count++;
     _scheduler.insert(this);
 
-    _stack = new (SYSTEM) char[stack_size];
+    unsigned int bytes = stack_guard ? stack_size + 2 * sizeof(MMU::Page) : stack_size;
+    char * block;
+    if(Traits<MMU>::colorful && (color != WHITE))
+        block = new (color) char[bytes];
+    else
+        block = new (SYSTEM) char[bytes];
+
+    if(stack_guard) {
+        // The stack sits right above a whole page that is invalidated, so overflows fault instead of corrupting the heap
+        // The block's address is kept in the word under the guard, for the destructor
+        char * guard = MMU::align_page(Log_Addr(block + sizeof(char *)));
+        reinterpret_cast<char **>(guard)[-1] = block;
+        _stack = guard + sizeof(MMU::Page);
+        if(!MMU::guard(guard, true))
+            db<Thread>(WRN) << "Thread: could not guard the stack at " << reinterpret_cast<void *>(_stack) << "!" << endl;
+    } else
+        _stack = block;
+    _stack_size = stack_size;
+
+    if(stack_painting)
+        memset(_stack, STACK_PAINT, stack_size);
     _acquired_synchronizers = new Synchronizer_Queue;
     _waiting = new Thread_Queue;
 }
@@ -59,6 +79,12 @@ void Thread::constructor_epilogue(Log_Addr entry, unsigned int stack_size)
 }
 
 
+void * Thread::operator new(size_t bytes, const System_Allocator & allocator)
+{
+    return Object_Cache<Thread>::alloc(bytes);
+}
+
+
 Thread::~Thread()
 {
     lock();
@@ -67,7 +93,9 @@ Thread::~Thread()
                     << ",state=" << _state
                     << ",priority=" << _link.rank()
                     << ",stack={b=" << reinterpret_cast<void *>(_stack)
-                    << ",context={b=" << _context
+                    << ",s=" << _stack_size
+                    << ",hw=" << stack_high_water()
+                    << "},context={b=" << _context
                     << "," << *_context << "})" << endl;
 
     // The running thread cannot delete itself!
@@ -105,7 +133,29 @@ Thread::~Thread()
 
     delete _acquired_synchronizers;
     delete _waiting;
-    delete _stack;
+    if(stack_guard) {
+        char * guard = _stack - sizeof(MMU::Page);
+        MMU::guard(guard, false);
+        delete reinterpret_cast<char **>(guard)[-1];
+    } else
+        delete _stack;
+}
+
+
+unsigned int Thread::stack_high_water() const
+{
+    if(!stack_painting)
+        return 0;
+
+    // Stacks grow down, so the lowest word that is no longer painted marks the deepest they have gone
+    // The first word is skipped, since it holds the exit status (see exit())
+    static const unsigned long PAINT = ~0UL / 0xff * STACK_PAINT;
+    const unsigned long * top = reinterpret_cast<const unsigned long *>(_stack + _stack_size);
+    const unsigned long * w = reinterpret_cast<const unsigned long *>(_stack) + 1;
+    while((w < top) && (*w == PAINT))
+        w++;
+
+    return reinterpret_cast<const char *>(top) - reinterpret_cast<const char *>(w);
 }
 
 
@@ -280,19 +330,29 @@ void Thread::wakeup(Thread_Queue * q)
 
     assert(locked()); // locking handled by caller
 
-    if(!q->empty()) {
-        Thread * t = q->remove()->object();
-        t->_state = READY;
-        t->_waiting = 0;
-        _scheduler.resume(t);
+    if(!q->empty())
+        wakeup(q->head()->object());
+}
 
-        if(preemptive) {
-            if (Criterion::core_scheduling == Criterion::GLOBAL_MULTICORE) {
-                for (unsigned long i = 0; i < Traits<Build>::CPUS; i++)
-                    reschedule(i);
-            } else
-                reschedule(t->_link.rank().queue());
-        }
+
+void Thread::wakeup(Thread * t)
+{
+    db<Thread>(TRC) << "Thread::wakeup(running=" << running() << ",t=" << t << ")" << endl;
+
+    assert(locked()); // locking handled by caller
+    assert(t->_state == WAITING);
+
+    t->_waiting->remove(&t->_link);
+    t->_state = READY;
+    t->_waiting = 0;
+    _scheduler.resume(t);
+
+    if(preemptive) {
+        if (Criterion::core_scheduling == Criterion::GLOBAL_MULTICORE) {
+            for (unsigned long i = 0; i < Traits<Build>::CPUS; i++)
+                reschedule(i);
+        } else
+            reschedule(t->_link.rank().queue());
     }
 }
 
@@ -318,6 +378,20 @@ void Thread::wakeup_all(Thread_Queue * q)
     }
 }
 
+
+// Moves a waiting thread to another queue without waking it up (e.g. from a condition variable to a mutex)
+void Thread::requeue(Thread * t, Thread_Queue * q)
+{
+    db<Thread>(TRC) << "Thread::requeue(t=" << t << ",from=" << t->_waiting << ",to=" << q << ")" << endl;
+
+    assert(locked()); // locking handled by caller
+    assert(t->_state == WAITING);
+
+    t->_waiting->remove(&t->_link);
+    t->_waiting = q;
+    q->insert(&t->_link);
+}
+
 void Thread::acquire_synchronizer(Synchronizer_Common * synchronizer) {
     db<Thread>(TRC) << "Thread::acquire_resource(synchronizer=" << synchronizer << ") [running=" << running() << "]" << endl;
 
@@ -332,7 +406,7 @@ void Thread::acquire_synchronizer(Synchronizer_Common * synchronizer) {
     if (running_priority == MAIN)
         return;
 
-    running->_acquired_synchronizers->insert(new (SYSTEM) Synchronizer_Queue::Element(synchronizer));
+    running->_acquired_synchronizers->insert(Object_Cache<Synchronizer_Queue::Element>::create(synchronizer));
     synchronizer->save_thread_priority(running, running_priority);
 }
 
@@ -351,6 +425,8 @@ void Thread::release_synchronizer(Synchronizer_Common * synchronizer) {
     synchronizer->priority_raised(false);
 
     Synchronizer_Queue::Element * removed = running->_acquired_synchronizers->remove(synchronizer);
+    if(!removed) // the running thread didn't acquire it (e.g. MAIN)
+        return;
 
     Criterion max = IDLE;
 
@@ -455,6 +531,11 @@ void Thread::reschedule()
 
     assert(locked()); // locking handled by caller
 
+    if(IC::on_interrupt_stack()) { // threads can't be switched there (see IC::entry())
+        IC::defer_reschedule();
+        return;
+    }
+
     Thread * prev = running();
     Thread * next = prev;
 
@@ -14,6 +14,10 @@ void CPU::init()
     _cpu_current_clock = System::info()->tm.cpu_clock;
     _bus_clock = System::info()->tm.bus_clock;
 
+    // Enable 4 MB pages, so page tables can be attached as superpages
+    if(Traits<MMU>::enabled && Traits<MMU>::superpages)
+        cr4(cr4() | CR4_PSE);
+
     // Initialize the MMU
     if(Traits<MMU>::enabled)
         MMU::init();
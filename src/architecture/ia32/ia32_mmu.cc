@@ -5,7 +5,7 @@
 __BEGIN_SYS
 
 // Class attributes
-MMU::List MMU::_free[colorful * COLORS + 1];
+MMU::Buddy MMU::_free;
 MMU::Page_Directory * MMU::_master;
 
 __END_SYS
@@ -22,77 +22,21 @@ void MMU::init()
 
     // BIG NOTE HERE: INIT (i.e. this program) will be part of the free
     // storage after the following is executed, but it will remain alive
-    // This only works because the _free.insert_merging() only
-    // touches the first page of each chunk and INIT is not there
+    // This only works because the buddy allocator keeps its links apart
+    // and never touches free frames
 
-    if(colorful) {
-        int f1b = si->pmm.free1_base;
-        int f1t = si->pmm.free1_top;
-        int f2b = si->pmm.free2_base;
-        int f2t = si->pmm.free2_top;
-        int f3b = si->pmm.free3_base;
-        int f3t = si->pmm.free3_top;
+    // The buddy allocator's tables come from the top of the large chunk, far above INIT
+    Phy_Addr tables = si->pmm.free2_top - pages(Buddy::TABLES) * sizeof(Page);
+    _free.init(phy2log(tables));
+    db<Init, MMU>(INF) << "MMU::buddy={tables=" << tables << ",size=" << Buddy::TABLES / 1024 << "KB}" << endl;
 
-        // Insert a bulk of memory large enough to contain the System's heap into _free[WHITE] lists
-        int size = Traits<System>::HEAP_SIZE;
-        if((f1t - f1b) > size) {
-            white_free(f1b, pages(f1b + size));
-            f1b += size;
-            size = 0;
-        } else {
-            white_free(f1b, pages(f1t - f1b));
-            size -= (f1t - f1b);
-            f1b = f1t = 0;
-        }
-        if(size > 0) {
-            if((f2t - f2b) > size) {
-                white_free(f2b, pages(f2b + size));
-                f2b += size;
-                size = 0;
-            } else {
-                white_free(f2b, pages(f2t - f2b));
-                size -= (f2t - f2b);
-                f2b = f2t = 0;
-            }
-        }
-        if(size > 0) {
-            if((f3t - f3b) > size) {
-                white_free(f3b, pages(f3b + size));
-                f3b += size;
-                size = 0;
-            } else {
-                white_free(f3b, pages(f3t - f3b));
-                size -= (f3t - f3b);
-                f3b = f3t = 0;
-            }
-        }
-        if((size > 0) || (_free[WHITE].grouped_size() * sizeof(Page) < Traits<System>::HEAP_SIZE))
-            db<Init, MMU>(ERR) << "MMU::int: System's heap size (Traits<System>::HEAP_SIZE=" << Traits<System>::HEAP_SIZE << ") is larger than memory!" << endl;
+    // Insert all free memory into the buddy allocator (frames of each color are split off it on demand)
+    free(si->pmm.free1_base, pages(si->pmm.free1_top - si->pmm.free1_base));
+    free(si->pmm.free2_base, pages(tables - si->pmm.free2_base));
+    free(si->pmm.free3_base, pages(si->pmm.free3_top - si->pmm.free3_base));
 
-        // Insert the remaining free memory into the _free[color] lists
-        int frame = f1b;
-        while(frame < f1t) {
-            free(frame);
-            frame += sizeof(Page);
-        }
-
-        frame = f2b;
-        while(frame < f2t) {
-            free(frame);
-            frame += sizeof(Page);
-        }
-
-        frame = f3b;
-        while(frame < f3t) {
-            free(frame);
-            frame += sizeof(Page);
-        }
-    } else {
-        // Insert all free memory into the _free[WHITE] list
-        free(si->pmm.free1_base, pages(si->pmm.free1_top - si->pmm.free1_base));
-        free(si->pmm.free2_base, pages(si->pmm.free2_top - si->pmm.free2_base));
-        free(si->pmm.free3_base, pages(si->pmm.free3_top - si->pmm.free3_base));
-    }
+    if(_free.frames() * sizeof(Page) < Traits<System>::HEAP_SIZE)
+        db<Init, MMU>(ERR) << "MMU::init: System's heap size (Traits<System>::HEAP_SIZE=" << Traits<System>::HEAP_SIZE << ") is larger than memory!" << endl;
 
     // Remember the master page directory (created during SETUP)
     _master = current();
@@ -31,7 +31,15 @@ public:
         if (Boot_Synchronizer::acquire_single_core_section()) {
             db<Init>(INF) << "Initializing system's heap: " << endl;
             if(Traits<System>::multiheap) {
-                System::_heap_segment = new (&System::_preheap[0]) Segment(HEAP_SIZE, Segment::Flags::SYSD);
+                // With colorful, half of HEAP_SIZE is split into one heap per color, each made of frames of its color
+                // appended to the system's heap segment, so all heaps are mapped in the system's range (at SYS_HEAP)
+                unsigned long colored = Traits<MMU>::colorful ? MMU::pages(HEAP_SIZE / 2 / MMU::colors()) * sizeof(MMU::Page) : 0;
+                System::_heap_segment = new (&System::_preheap[0]) Segment(HEAP_SIZE - colored * MMU::colors(), Segment::Flags::SYSD);
+                unsigned long size = System::_heap_segment->size();
+                if(colored)
+                    for(unsigned int c = 0; c < MMU::colors(); c++)
+                        System::_heap_segment->resize(colored, Color(c));
+
                 char * heap;
                 if(Memory_Map::SYS_HEAP == Traits<Machine>::NOT_USED)
                     heap = Address_Space(MMU::current()).attach(System::_heap_segment);
@@ -39,7 +47,17 @@ public:
                     heap = Address_Space(MMU::current()).attach(System::_heap_segment, Memory_Map::SYS_HEAP);
                 if(!heap)
                     db<Init>(ERR) << "Failed to initialize the system's heap!" << endl;
-                System::_heap = new (&System::_preheap[sizeof(Segment)]) Heap(heap, System::_heap_segment->size());
+                System::_heap_address = heap;
+                System::_heap = new (&System::_preheap[sizeof(Segment)]) Heap(heap, size);
+
+                if(colored) {
+                    db<Init>(INF) << "Initializing colored heaps: " << endl;
+                    for(unsigned int c = 0; c < MMU::colors(); c++)
+                        if(System::_heap_segment->size() >= size + (c + 1) * colored)
+                            System::_heaps[c] = new (SYSTEM) Heap(heap + size + c * colored, colored);
+                        else
+                            db<Init>(WRN) << "Failed to initialize the heap of color " << c << "!" << endl;
+                }
             } else
                 System::_heap = new (&System::_preheap[0]) Heap(MMU::alloc(MMU::pages(HEAP_SIZE)), HEAP_SIZE);
         }
@@ -13,31 +13,78 @@ __BEGIN_SYS
 
 PLIC::Reg32 PLIC::_claimed;
 IC::Interrupt_Handler IC::_int_vector[IC::INTS];
+char IC::_stack[interrupt_stacks ? CPUS : 1][interrupt_stacks ? STACK_SIZE : 1] __attribute__((aligned(16)));
+IC::Reg IC::_sp[IC::CPUS];
+unsigned int IC::_nesting[IC::CPUS];
+volatile bool IC::_deferred[IC::CPUS];
 
 void IC::entry()
 {
     // Save context into the stack
     CPU::Context::push(true);
 
-    if(Traits<Frequency_Profiler>::profiled)
-        Frequency_Profiler::measure_initial_time();
-
     if(Traits<IC>::hysterically_debugged)
         print_context(true);
 
-    dispatch();
+    // Handlers run on this CPU's interrupt stack, while the context stays on the interrupted one
+    if(interrupt_stacks)
+        CPU::sp(stack_enter(CPU::sp()));
 
-    if(Traits<IC>::hysterically_debugged)
-        print_context(false);
+    if(Traits<Frequency_Profiler>::profiled)
+        Frequency_Profiler::measure_initial_time();
+
+    dispatch();
 
     if(Traits<Frequency_Profiler>::profiled)
         Frequency_Profiler::measure_final_time();
 
+    if(interrupt_stacks) {
+        CPU::sp(stack_leave(CPU::sp()));
+        preempt();
+    }
+
+    if(Traits<IC>::hysterically_debugged)
+        print_context(false);
+
     // Restore context from the stack
     CPU::Context::pop(true);
     CPU::iret();
 }
 
+IC::Reg IC::stack_enter(Reg sp)
+{
+    // Nested interrupts (and exceptions raised by handlers) just keep on using the interrupt stack
+    unsigned int cpu = CPU::id();
+    if(_nesting[cpu]++)
+        return sp;
+
+    _sp[cpu] = sp;
+    return reinterpret_cast<Reg>(&_stack[cpu][STACK_SIZE]);
+}
+
+IC::Reg IC::stack_leave(Reg sp)
+{
+    CPU::int_disable(); // handlers might have reenabled interrupts, but the context to be popped has the right status
+
+    unsigned int cpu = CPU::id();
+    if(--_nesting[cpu])
+        return sp;
+
+    return _sp[cpu];
+}
+
+void IC::preempt()
+{
+    // Back on the interrupted thread's stack, rescheduling deferred by handlers can finally switch threads
+    unsigned int cpu = CPU::id();
+    if(!_nesting[cpu] && _deferred[cpu]) {
+        _deferred[cpu] = false;
+        Thread::lock();
+        Thread::reschedule();
+        Thread::unlock();
+    }
+}
+
 void IC::dispatch()
 {
     Interrupt_Id id = int_id();
@@ -63,6 +110,11 @@ void IC::int_not(Interrupt_Id id)
 
 void IC::exception(Interrupt_Id id)
 {
+    // Pages of lazy segments are only backed when first touched
+    if(((id == CPU::EXC_IPF) || (id == CPU::EXC_DRPF) || (id == CPU::EXC_DWPF))
+       && MMU::fault(CPU::tval(), (id == CPU::EXC_DWPF) ? MMU::Flags::WR : (id == CPU::EXC_IPF) ? MMU::Flags::EX : MMU::Flags::RD))
+        return;
+
     CPU::Log_Addr sp = CPU::sp();
     CPU::Log_Addr epc = CPU::epc();
     CPU::Reg status = CPU::status();
@@ -119,6 +171,13 @@ void IC::exception(Interrupt_Id id)
     db<IC, System>(WRN) << endl;
 
     db<IC, Machine>(WRN) << "The running thread will now be terminated!" << endl;
+
+    // This handler never returns, so the interrupt stack is given up right away
+    if(interrupt_stacks) {
+        _nesting[CPU::id()] = 0;
+        _deferred[CPU::id()] = false;
+    }
+
     Thread::exit(-1);
 }
 
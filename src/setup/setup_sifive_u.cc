@@ -113,7 +113,7 @@ void Setup::setup_flat_paging()
 {
     db<Setup>(TRC) << "Setup::setup_flat_paging()" << endl;
 
-    // Single-level mapping, 2 MB pages with SV32 and 1 GB pages with SV39
+    // Single-level mapping, 4 MB megapages with SV32 and 1 GB gigapages with SV39
     static const unsigned long PD_ENTRIES = (Math::max(RAM_TOP, MIO_TOP) - Math::min(RAM_BASE, MIO_BASE) + sizeof(MMU::Huge_Page) - 1) / sizeof(MMU::Huge_Page);
 
     Page_Directory * pd = reinterpret_cast<Page_Directory *>(FLAT_MEM_MAP);
@@ -20,7 +20,25 @@ OStream kerr;
 System_Info * System::_si = (Memory_Map::SYS_INFO != Memory_Map::NOT_USED) ? reinterpret_cast<System_Info *>(Memory_Map::SYS_INFO) : reinterpret_cast<System_Info *>(&__boot_time_system_info);
 char System::_preheap[];
 Segment * System::_heap_segment;
+char * System::_heap_address;
 Heap * System::_heap;
+Heap * System::_heaps[];
+
+// Methods
+unsigned long System::trim()
+{
+    unsigned long bytes = 0;
+
+    if(Traits<System>::multiheap && !Traits<MMU>::colorful && _heap_address) { // colored heaps lie at the segment's end
+        bytes = _heap->trim(_heap_address + _heap_segment->size(), sizeof(MMU::Page));
+        if(bytes)
+            Address_Space(MMU::current()).resize(_heap_segment, _heap_address, -long(bytes));
+    }
+
+    db<System>(TRC) << "System::trim() => " << bytes << endl;
+
+    return bytes;
+}
 
 __END_SYS
 
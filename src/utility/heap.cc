@@ -1,12 +1,330 @@
 // EPOS Heap Utility Implementation
 
 #include <utility/heap.h>
+#include <utility/string.h>
 
 __BEGIN_UTIL
 
+Object_Cache_Common::Release * Object_Cache_Common::_caches[Object_Cache_Common::MAX_CACHES];
+volatile unsigned int Object_Cache_Common::_count;
+
 void Heap::out_of_memory(unsigned long bytes)
 {
+    _statistics.failed();
+
     db<Heaps, System>(ERR) << "Heap::alloc(this=" << this << "): out of memory while allocating " << bytes << " bytes!" << endl;
 }
 
+
+void * Heap::alloc(unsigned long bytes, unsigned long align)
+{
+    // Blocks are always aligned to pointers (cached ones included), so only larger alignments need the engine's help
+    if(align <= sizeof(void *))
+        return alloc(bytes);
+
+    if(!bytes || (align & (align - 1)))
+        return 0;
+
+    lock();
+
+    db<Heaps>(TRC) << "Heap::alloc(this=" << this << ",bytes=" << bytes << ",align=" << align;
+
+    unsigned long requested = bytes;
+
+    while((bytes % sizeof(void *)))
+        ++bytes;
+
+    unsigned long header = (typed ? sizeof(void *) : 0) + sizeof(long);
+    bytes += header;
+
+    // The header lies right before the aligned address, so the engine aligns the block plus "header" bytes
+    long * addr = reinterpret_cast<long *>(Engine::alloc_aligned(&bytes, align, header));
+    if(!addr) {
+        unlock();
+        out_of_memory(bytes);
+        return 0;
+    }
+
+    if(typed)
+        *addr++ = reinterpret_cast<long>(this);
+    *addr++ = bytes;
+
+    _statistics.allocated(requested, bytes, __builtin_return_address(0));
+
+    db<Heaps>(TRC) << ") => " << reinterpret_cast<void *>(addr) << endl;
+
+    unlock();
+
+    return addr;
+}
+
+
+void * Heap::realloc(void * ptr, unsigned long bytes)
+{
+    if(!ptr)
+        return alloc(bytes);
+
+    if(!bytes) {
+        if(typed)
+            typed_free(ptr);
+        else
+            untyped_free(this, ptr);
+        return 0;
+    }
+
+    unsigned long usable = usable_size(ptr);
+    if(bytes <= usable)
+        return ptr;
+
+    long * addr = reinterpret_cast<long *>(ptr);
+    unsigned long old = addr[-1];
+    if(!Object_Cache_Common::tagged(old) && !(cached && (old & CACHED))) {
+        unsigned long header = (typed ? sizeof(void *) : 0) + sizeof(long);
+        unsigned long grown = bytes;
+        while((grown % sizeof(void *)))
+            ++grown;
+        grown += header;
+
+        lock();
+
+        bool in_place = Engine::grow(reinterpret_cast<char *>(ptr) - header, old, grown);
+        if(in_place) {
+            addr[-1] = grown;
+            _statistics.freed(old);
+            _statistics.allocated(bytes, grown, __builtin_return_address(0));
+        }
+
+        db<Heaps>(TRC) << "Heap::realloc(this=" << this << ",ptr=" << ptr << ",bytes=" << bytes << ") => " << (in_place ? ptr : 0) << endl;
+
+        unlock();
+
+        if(in_place)
+            return ptr;
+    }
+
+    void * block = alloc(bytes);
+    if(block) {
+        memcpy(block, ptr, usable);
+        if(typed)
+            typed_free(ptr);
+        else
+            untyped_free(this, ptr);
+    }
+
+    return block;
+}
+
+
+// Magazines are only touched by their own CPU with interrupts disabled, so they need no locking
+void * Heap::cached_alloc(unsigned long bytes, void * site)
+{
+    unsigned int c = 0;
+    while((MIN_CLASS << c) < bytes)
+        c++;
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+
+    unsigned int cpu = CPU::id();
+    Magazine * m = &_magazines[cpu][c];
+    if(!m->count) {
+        reclaim(cpu);
+        if(!m->count)
+            refill(cpu, c);
+    }
+    void * ptr = m->count ? m->blocks[--m->count] : 0;
+
+    if(enabled)
+        CPU::int_enable();
+
+    db<Heaps>(TRC) << "Heap::alloc(this=" << this << ",bytes=" << bytes << ",class=" << c << ",cpu=" << cpu << ") => " << ptr << endl;
+
+    if(ptr)
+        _statistics.allocated(bytes, block_size(c), site);
+    else
+        out_of_memory(bytes);
+
+    return ptr;
+}
+
+
+void Heap::cached_free(void * ptr, unsigned long tag)
+{
+    unsigned int c = tag & 0xff;
+    unsigned int home = (tag >> 8) & 0xff;
+
+    bool enabled = CPU::int_enabled();
+    CPU::int_disable();
+
+    unsigned int cpu = CPU::id();
+
+    db<Heaps>(TRC) << "Heap::free(this=" << this << ",ptr=" << ptr << ",class=" << c << ",home=" << home << ",cpu=" << cpu << ")" << endl;
+
+    _statistics.freed(block_size(c));
+
+    if(home != cpu) {
+        void * volatile * link = reinterpret_cast<void * volatile *>(ptr);
+        void * head;
+        do {
+            head = _returned[home];
+            *link = head;
+        } while(CPU::cas(_returned[home], head, ptr) != head);
+    } else {
+        Magazine * m = &_magazines[cpu][c];
+        if(m->count == MAGAZINE_SIZE)
+            flush(cpu, c, BATCH);
+        m->blocks[m->count++] = ptr;
+    }
+
+    if(enabled)
+        CPU::int_enable();
+}
+
+
+// Takes all blocks other CPUs gave back to "cpu" (interrupts disabled)
+void Heap::reclaim(unsigned int cpu)
+{
+    void * list;
+    do
+        list = _returned[cpu];
+    while(list && (CPU::cas(_returned[cpu], list, static_cast<void *>(0)) != list));
+
+    while(list) {
+        void * ptr = list;
+        list = *reinterpret_cast<void **>(ptr);
+
+        unsigned int c = reinterpret_cast<long *>(ptr)[-1] & 0xff;
+        Magazine * m = &_magazines[cpu][c];
+        if(m->count == MAGAZINE_SIZE)
+            flush(cpu, c, BATCH);
+        m->blocks[m->count++] = ptr;
+    }
+}
+
+
+void Heap::refill(unsigned int cpu, unsigned int c)
+{
+    Magazine * m = &_magazines[cpu][c];
+
+    lock();
+
+    for(unsigned int i = 0; i < BATCH; i++) {
+        long * addr = reinterpret_cast<long *>(Engine::alloc(block_size(c)));
+        if(!addr)
+            break;
+
+        if(typed)
+            *addr++ = reinterpret_cast<long>(this);
+        *addr++ = tag(cpu, c);
+        m->blocks[m->count++] = addr;
+    }
+
+    unlock();
+}
+
+
+void Heap::flush(unsigned int cpu, unsigned int c, unsigned int n)
+{
+    Magazine * m = &_magazines[cpu][c];
+
+    lock();
+
+    for(unsigned int i = 0; (i < n) && m->count; i++) {
+        long * addr = reinterpret_cast<long *>(m->blocks[--m->count]);
+        addr -= typed ? 2 : 1;
+        Engine::free(addr, block_size(c));
+    }
+
+    unlock();
+}
+
+
+
+Heap::Statistics Heap::statistics()
+{
+    Statistics s;
+    _statistics.fill(&s);
+
+    lock();
+    s.free = Engine::grouped_size();
+    s.largest = Engine::largest();
+    unlock();
+
+    s.fragmentation = s.free ? 100 - static_cast<unsigned int>(static_cast<unsigned long long>(s.largest) * 100 / s.free) : 0;
+
+    return s;
+}
+
+
+void Heap::report(OStream & os, unsigned int n)
+{
+    Statistics s = statistics();
+
+    os << "Heap " << this << ": in use=" << s.in_use << ",peak=" << s.peak << ",allocations=" << s.allocations
+       << ",frees=" << s.frees << ",failures=" << s.failures << ",free=" << s.free << ",largest=" << s.largest
+       << ",fragmentation=" << s.fragmentation << "%" << endl;
+
+    os << "Allocations by size:";
+    for(unsigned int i = 0; i < Heap_Statistics_Common::SIZES - 1; i++)
+        os << " <=" << (16UL << i) << ":" << s.sizes[i];
+    os << " >" << (16UL << (Heap_Statistics_Common::SIZES - 2)) << ":" << s.sizes[Heap_Statistics_Common::SIZES - 1] << endl;
+
+    _statistics.report(os, n);
+}
+
+
+Heap_Statistics<true>::Site * Heap_Statistics<true>::entry(void * site)
+{
+    unsigned long key = reinterpret_cast<unsigned long>(site);
+    unsigned int h = (key >> 2) % SITES;
+
+    // Open addressing, as in Lock_Profiler::entry()
+    for(unsigned int i = 0; i < SITES; i++) {
+        Site * s = &_sites[(h + i) % SITES];
+        unsigned long owner = s->site;
+        if(!owner)
+            owner = CPU::cas(s->site, 0UL, key);
+        if(!owner || (owner == key))
+            return s;
+    }
+
+    _lost.finc();
+    return 0;
+}
+
+
+void Heap_Statistics<true>::report(OStream & os, unsigned int n) const
+{
+    if(!Traits<Heaps>::call_sites)
+        return;
+
+    bool listed[SITES];
+    for(unsigned int i = 0; i < SITES; i++)
+        listed[i] = false;
+
+    os << "Allocation sites:" << endl;
+
+    for(unsigned int k = 0; k < n; k++) {
+        const Site * top = 0;
+        unsigned int index = 0;
+        for(unsigned int i = 0; i < SITES; i++) {
+            const Site * s = &_sites[i];
+            if(!s->site || listed[i])
+                continue;
+            if(!top || (s->bytes > top->bytes)) {
+                top = s;
+                index = i;
+            }
+        }
+        if(!top)
+            break;
+        listed[index] = true;
+
+        os << k + 1 << ": site=" << reinterpret_cast<void *>(top->site) << ",allocations=" << top->allocations << ",bytes=" << top->bytes << endl;
+    }
+
+    if(_lost)
+        os << "Heap_Statistics: " << _lost << " allocations not attributed (increase Traits<Heaps>::PROFILED_SITES)" << endl;
+}
+
 __END_UTIL
@@ -0,0 +1,102 @@
+// EPOS Lock Contention Profiler Utility Implementation
+
+#include <utility/lock_profiler.h>
+
+__BEGIN_UTIL
+
+Lock_Profiler::Entry Lock_Profiler::_entries[Lock_Profiler::ENTRIES];
+volatile unsigned long Lock_Profiler::_lost;
+
+Lock_Profiler::Entry * Lock_Profiler::entry(const volatile void * lock, void * site)
+{
+    unsigned long key = reinterpret_cast<unsigned long>(lock);
+    unsigned long where = reinterpret_cast<unsigned long>(site);
+    unsigned int h = ((key >> 3) ^ (where >> 2)) % ENTRIES;
+
+    // Open addressing: a slot is claimed by setting its lock, which is never cleared but by reset()
+    // The lock is first set to CLAIMING, with interrupts disabled, so the site is published before lookups can match
+    // the slot and nothing on the claiming CPU waits for it to finish
+    for(unsigned int i = 0; i < ENTRIES; i++) {
+        Entry * e = &_entries[(h + i) % ENTRIES];
+        unsigned long owner = e->lock;
+        if(!owner) {
+            bool enabled = CPU::int_enabled();
+            CPU::int_disable();
+            owner = CPU::cas(e->lock, 0UL, CLAIMING);
+            if(!owner) {
+                e->site = where;
+                CPU::memory_barrier();
+                e->lock = key;
+            }
+            if(enabled)
+                CPU::int_enable();
+            if(!owner)
+                return e;
+        }
+        while(owner == CLAIMING) {
+            CPU::pause();
+            owner = e->lock;
+        }
+        CPU::memory_barrier();
+        if((owner == key) && (e->site == where))
+            return e;
+    }
+
+    CPU::finc(_lost);
+    return 0;
+}
+
+
+void Lock_Profiler::report(OStream & os, unsigned int n)
+{
+    bool listed[ENTRIES];
+    for(unsigned int i = 0; i < ENTRIES; i++)
+        listed[i] = false;
+
+    os << "Lock contention profile (times in TSC ticks at " << TSC::frequency() << " Hz):" << endl;
+
+    for(unsigned int k = 0; k < n; k++) {
+        Entry * top = 0;
+        unsigned int index = 0;
+        for(unsigned int i = 0; i < ENTRIES; i++) {
+            Entry * e = &_entries[i];
+            if(!e->lock || (e->lock == CLAIMING) || listed[i])
+                continue;
+            if(!top || (e->contentions > top->contentions) || ((e->contentions == top->contentions) && (e->spin > top->spin))) {
+                top = e;
+                index = i;
+            }
+        }
+        if(!top)
+            break;
+        listed[index] = true;
+
+        os << k + 1 << ": lock=" << reinterpret_cast<void *>(top->lock);
+        if(top->site)
+            os << ",site=" << reinterpret_cast<void *>(top->site);
+        os << ",acq=" << top->acquisitions << ",cont=" << top->contentions << ",blocked=" << top->blocked
+           << ",spin=" << top->spin << ",max_spin=" << top->max_spin << ",hold=" << top->hold << endl;
+    }
+
+    if(_lost)
+        os << "Lock_Profiler: " << _lost << " events lost (increase Traits<Spin>::PROFILED_LOCKS)" << endl;
+}
+
+
+void Lock_Profiler::reset()
+{
+    for(unsigned int i = 0; i < ENTRIES; i++) {
+        Entry * e = &_entries[i];
+        e->site = 0;
+        e->acquisitions = 0;
+        e->contentions = 0;
+        e->blocked = 0;
+        e->spin = 0;
+        e->max_spin = 0;
+        e->hold = 0;
+        e->lock = 0;
+    }
+    _lost = 0;
+}
+
+__END_UTIL
@@ -0,0 +1,286 @@
+// EPOS TLSF (Two-Level Segregated Fit) Allocator Utility Implementation
+
+#include <utility/tlsf.h>
+
+__BEGIN_UTIL
+
+void * TLSF::alloc(unsigned long bytes)
+{
+    if(!bytes || (bytes >= MAX_BLOCK))
+        return 0;
+
+    bytes = align_up(bytes);
+    if(bytes < MIN_BLOCK)
+        bytes = MIN_BLOCK;
+
+    unsigned int fl, sl;
+    mapping_search(bytes, &fl, &sl);
+    if(fl >= FL_COUNT)
+        return 0;
+
+    Block * b = search_suitable(&fl, &sl);
+    if(!b)
+        return 0;
+    remove(b, fl, sl);
+
+    if(block_size(b) >= sizeof(Block) + bytes) { // split and give the remainder back
+        Block * r = split(b, bytes);
+        link_next(b);
+        set_prev_free(r);
+        insert(r);
+    }
+    mark_as_used(b);
+
+    return to_ptr(b);
+}
+
+
+void * TLSF::alloc_aligned(unsigned long * bytes, unsigned long align, unsigned long offset)
+{
+    if(align <= ALIGN)
+        return alloc(*bytes);
+
+    unsigned long s = *bytes;
+    if(!s || (s >= MAX_BLOCK) || (align >= MAX_BLOCK))
+        return 0;
+
+    s = align_up(s);
+    if(s < MIN_BLOCK)
+        s = MIN_BLOCK;
+
+    // Any block this large holds the aligned block plus a gap before it that is either empty or a block of its own
+    unsigned long worst = s + align + sizeof(Block);
+    if(worst >= MAX_BLOCK)
+        return 0;
+
+    unsigned int fl, sl;
+    mapping_search(worst, &fl, &sl);
+    if(fl >= FL_COUNT)
+        return 0;
+
+    Block * b = search_suitable(&fl, &sl);
+    if(!b)
+        return 0;
+    remove(b, fl, sl);
+
+    unsigned long p = reinterpret_cast<unsigned long>(to_ptr(b)) + offset;
+    unsigned long gap = ((p + align - 1) & ~(align - 1)) - p;
+    while(gap && (gap < sizeof(Block)))
+        gap += align;
+
+    if(gap) { // split the gap off and give it back
+        Block * a = split(b, gap - OVERHEAD);
+        link_next(b);
+        set_prev_free(a);
+        insert(b);
+        b = a;
+    }
+
+    if(block_size(b) >= sizeof(Block) + s) {
+        Block * r = split(b, s);
+        link_next(b);
+        set_prev_free(r);
+        insert(r);
+    }
+    mark_as_used(b);
+
+    return to_ptr(b);
+}
+
+
+bool TLSF::grow(void * ptr, unsigned long old_bytes, unsigned long bytes)
+{
+    if(!ptr || (bytes >= MAX_BLOCK))
+        return false;
+
+    bytes = align_up(bytes);
+    Block * b = from_ptr(ptr);
+    if(block_size(b) >= bytes)
+        return true;
+
+    Block * n = next(b);
+    if(!is_free(n) || (block_size(b) + OVERHEAD + block_size(n) < bytes))
+        return false;
+
+    remove(n);
+    absorb(b, n);
+    if(block_size(b) >= sizeof(Block) + bytes) {
+        Block * r = split(b, bytes);
+        link_next(b);
+        set_prev_free(r);
+        insert(r);
+    }
+    mark_as_used(b);
+
+    return true;
+}
+
+
+void TLSF::free(void * ptr, unsigned long bytes)
+{
+    if(!ptr)
+        return;
+
+    Block * b = from_ptr(ptr);
+    mark_as_free(b);
+
+    if(is_prev_free(b)) {
+        Block * p = b->prev;
+        remove(p);
+        b = absorb(p, b);
+    }
+
+    Block * n = next(b);
+    if(is_free(n)) {
+        remove(n);
+        b = absorb(b, n);
+    }
+
+    insert(b);
+}
+
+
+void TLSF::add(void * ptr, unsigned long bytes)
+{
+    unsigned long start = align_up(reinterpret_cast<unsigned long>(ptr));
+    unsigned long end = reinterpret_cast<unsigned long>(ptr) + bytes;
+    if((end <= start) || (end - start < POOL_OVERHEAD + MIN_BLOCK))
+        return;
+
+    unsigned long s = align_down(end - start - POOL_OVERHEAD);
+    if(s >= MAX_BLOCK)
+        s = MAX_BLOCK - ALIGN;
+
+    // The pool's first block starts one word before it, so its (never used) "prev" lies outside the pool
+    Block * b = offset(reinterpret_cast<void *>(start), -long(OVERHEAD));
+    b->size = s;
+    set_free(b);
+    set_prev_used(b);
+    insert(b);
+
+    // A zero-sized used sentinel closes the pool, so merging never crosses it
+    Block * t = link_next(b);
+    t->size = 0;
+    set_used(t);
+    set_prev_free(t);
+}
+
+
+unsigned long TLSF::trim(void * end, unsigned long unit)
+{
+    // The pool's sentinel lies right below its end (see add()), so the pool's last block is the free one just before it
+    // Free blocks are found by their addresses only, so a wrong "end" never makes us touch memory out of the heap
+    Block * t = offset(reinterpret_cast<void *>(align_down(reinterpret_cast<unsigned long>(end))), -long(POOL_OVERHEAD));
+    for(unsigned int fl = 0; fl < FL_COUNT; fl++)
+        for(unsigned int sl = 0; sl < SL_COUNT; sl++)
+            for(Block * b = _blocks[fl][sl]; b != &_null; b = b->next_free)
+                if(next(b) == t) {
+                    if(block_size(b) < MIN_BLOCK + unit)
+                        return 0;
+
+                    unsigned long bytes = (block_size(b) - MIN_BLOCK) / unit * unit;
+                    remove(b, fl, sl);
+                    block_size(b, block_size(b) - bytes);
+                    t = link_next(b);
+                    t->size = 0;
+                    set_used(t);
+                    set_prev_free(t);
+                    insert(b);
+
+                    return bytes;
+                }
+
+    return 0;
+}
+
+
+unsigned long TLSF::largest() const
+{
+    if(!_fl_bitmap)
+        return 0;
+
+    unsigned int fl = fls(_fl_bitmap);
+    unsigned int sl = fls(_sl_bitmap[fl]);
+
+    unsigned long l = 0;
+    for(const Block * b = _blocks[fl][sl]; b != &_null; b = b->next_free)
+        if(block_size(b) > l)
+            l = block_size(b);
+
+    return l;
+}
+
+
+TLSF::Block * TLSF::search_suitable(unsigned int * fl, unsigned int * sl)
+{
+    unsigned int sl_map = _sl_bitmap[*fl] & (~0U << *sl);
+    if(!sl_map) {
+        unsigned int fl_map = _fl_bitmap & (~0U << (*fl + 1));
+        if(!fl_map)
+            return 0;
+        *fl = ffs(fl_map);
+        sl_map = _sl_bitmap[*fl];
+    }
+    *sl = ffs(sl_map);
+
+    return _blocks[*fl][*sl];
+}
+
+
+void TLSF::remove(Block * b, unsigned int fl, unsigned int sl)
+{
+    Block * p = b->prev_free;
+    Block * n = b->next_free;
+    n->prev_free = p;
+    p->next_free = n;
+
+    if(_blocks[fl][sl] == b) {
+        _blocks[fl][sl] = n;
+        if(n == &_null) {
+            _sl_bitmap[fl] &= ~(1U << sl);
+            if(!_sl_bitmap[fl])
+                _fl_bitmap &= ~(1U << fl);
+        }
+    }
+
+    _free_blocks--;
+    _free_bytes -= block_size(b);
+}
+
+
+void TLSF::insert(Block * b, unsigned int fl, unsigned int sl)
+{
+    Block * h = _blocks[fl][sl];
+    b->next_free = h;
+    b->prev_free = &_null;
+    h->prev_free = b;
+
+    _blocks[fl][sl] = b;
+    _fl_bitmap |= (1U << fl);
+    _sl_bitmap[fl] |= (1U << sl);
+
+    _free_blocks++;
+    _free_bytes += block_size(b);
+}
+
+
+TLSF::Block * TLSF::split(Block * b, unsigned long s)
+{
+    Block * r = offset(to_ptr(b), s - OVERHEAD);
+    r->size = block_size(b) - (s + OVERHEAD);
+    block_size(b, s);
+    mark_as_free(r);
+
+    return r;
+}
+
+
+TLSF::Block * TLSF::absorb(Block * prev, Block * b)
+{
+    prev->size += block_size(b) + OVERHEAD;
+    link_next(prev);
+
+    return prev;
+}
+
+__END_UTIL
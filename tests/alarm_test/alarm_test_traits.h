@@ -42,11 +42,37 @@ template<> struct Traits<Lists>: public Traits<Build>
 template<> struct Traits<Spin>: public Traits<Build>
 {
     static const bool debugged = hysterically_debugged;
+
+    // Core_Spin (kernel locks): CAS (test-and-test-and-set), TICKET (FIFO) or MCS (FIFO, local spinning)
+    enum {CAS, TICKET, MCS};
+    static const unsigned int algorithm = (CPUS > 1) ? TICKET : CAS;
+
+    // Contention profiling of Core_Spin (see Lock_Profiler::report())
+    static const bool profiled = false;
+    static const bool call_sites = false;         // also attribute statistics to the caller
+    static const unsigned int PROFILED_LOCKS = 64;
 };
 
 template<> struct Traits<Heaps>: public Traits<Build>
 {
     static const bool debugged = hysterically_debugged;
+
+    // Allocation engine: FIRST_FIT (address-ordered free list) or TLSF (two-level segregated fit, O(1))
+    enum {FIRST_FIT, TLSF};
+    static const unsigned int allocator = TLSF;
+
+    // Per-CPU magazines of small blocks in front of the engine
+    static const bool cached = (CPUS > 1);
+    static const unsigned int MAGAZINE_SIZE = 16;
+
+    // Per-type object caches (slabs) for kernel objects allocated with new (SYSTEM)
+    static const bool object_caches = true;
+    static const unsigned int SLAB_OBJECTS = 16;
+
+    // Usage statistics (see Heap::report())
+    static const bool statistics = false;
+    static const bool call_sites = false;         // also attribute allocations to the caller
+    static const unsigned int PROFILED_SITES = 32;
 };
 
 template<> struct Traits<Observers>: public Traits<Build>
@@ -100,7 +126,7 @@ template<> struct Traits<Application>: public Traits<Build>
 template<> struct Traits<System>: public Traits<Build>
 {
     static const bool multithread = (Traits<Application>::MAX_THREADS > 1);
-    static const bool multiheap = Traits<Scratchpad>::enabled;
+    static const bool multiheap = Traits<Scratchpad>::enabled || Traits<MMU>::colorful;
 
     static const unsigned long LIFE_SPAN = 1 * YEAR; // s
     static const unsigned int DUTY_CYCLE = 1000000; // ppm
@@ -118,6 +144,12 @@ template<> struct Traits<Thread>: public Traits<Build>
     static const bool simulate_capacity = false;
     static const int priority_inversion_protocol = NONE;
 
+    // Paint stacks when threads are created, so stack_high_water() can tell how deep they have ever gone
+    static const bool stack_painting = true;
+
+    // Invalidate the page right under each stack, so overflows fault (needs system memory mapped by page tables)
+    static const bool stack_guard = false;
+
     typedef RR Criterion;
     static const unsigned int QUANTUM = 10000; // us
 };
@@ -130,6 +162,16 @@ template<> struct Traits<Scheduler<Thread>>: public Traits<Build>
 template<> struct Traits<Synchronizer>: public Traits<Build>
 {
     static const bool enabled = Traits<System>::multithread;
+
+    // Adaptive Mutex: spin while the owner is running on another CPU before blocking
+    static const bool adaptive = (CPUS > 1);
+    static const unsigned int MAX_SPINS = 1000;   // upper bound for the self-tuned spin phase
+
+    // RW_Lock: blocked writers go ahead of readers arriving later
+    static const bool writer_preference = true;
+
+    // Contention profiling of synchronizers (see Lock_Profiler::report())
+    static const bool profiled = false;
 };
 
 template<> struct Traits<Alarm>: public Traits<Build>
@@ -0,0 +1,241 @@
+// EPOS Heap Trace-Replay Benchmark
+
+// Replays synthetic allocation traces (mostly small, short-lived blocks with a tail of larger ones) against a
+// private heap and prints the distribution of alloc() and free() latencies followed by the heap's statistics.
+// The trace is first replayed by main alone and then by one thread per CPU at once, each with its own trace,
+// so with more than one CPU the per-CPU magazines and the returns of blocks freed by other CPUs are measured too.
+// Blocks are freed through the typed or the untyped path, as configured by Traits<System>::multiheap
+// (tests/heap_typed_test replays the same traces with multiheap).
+
+#include <architecture/tsc.h>
+#include <utility/heap.h>
+#include <utility/ostream.h>
+#include <process.h>
+
+using namespace EPOS;
+
+const unsigned int CPUS = Traits<Build>::CPUS;
+const unsigned int POOL_SIZE = CPUS * 512 * 1024;
+const unsigned int SLOTS = 256;
+const unsigned int OPERATIONS = 8192;
+const unsigned int ROUNDS = 4;
+const unsigned int BUCKETS = 16;        // latency histogram: [0, 2), [2, 4), [4, 8), ... TSC ticks
+
+typedef TSC::Time_Stamp Time_Stamp;
+
+struct Operation
+{
+    unsigned short slot;
+    unsigned int bytes;                 // 0 => free
+};
+
+struct Latency
+{
+    unsigned long count;
+    Time_Stamp min;
+    Time_Stamp max;
+    Time_Stamp total;
+    unsigned long histogram[BUCKETS];
+};
+
+struct Replayer
+{
+    Operation trace[OPERATIONS];
+    void * blocks[SLOTS];
+    Latency alloc;
+    Latency free;
+};
+
+OStream cout;
+
+char pool[POOL_SIZE];
+Heap * heap;
+Replayer replayers[CPUS];
+unsigned long seed = 1;
+
+unsigned long lcg()
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+unsigned int request_size()
+{
+    unsigned long p = lcg() % 100;
+    if(p < 60)
+        return 16 + lcg() % 49;
+    if(p < 85)
+        return 65 + lcg() % 448;
+    if(p < 97)
+        return 513 + lcg() % 3584;
+    return 4097 + lcg() % 28672;
+}
+
+void generate(Operation * trace)
+{
+    bool live[SLOTS];
+    for(unsigned int i = 0; i < SLOTS; i++)
+        live[i] = false;
+
+    for(unsigned int i = 0; i < OPERATIONS; i++) {
+        unsigned int s = lcg() % SLOTS;
+        trace[i].slot = s;
+        trace[i].bytes = live[s] ? 0 : request_size();
+        live[s] = !live[s];
+    }
+}
+
+void record(Latency * l, Time_Stamp t)
+{
+    if(!l->count || (t < l->min))
+        l->min = t;
+    if(t > l->max)
+        l->max = t;
+    l->total += t;
+    l->count++;
+
+    unsigned int b = 0;
+    for(Time_Stamp x = t >> 1; x && (b < BUCKETS - 1); x >>= 1)
+        b++;
+    l->histogram[b]++;
+}
+
+void merge(Latency * l, const Latency & m)
+{
+    if(!m.count)
+        return;
+    if(!l->count || (m.min < l->min))
+        l->min = m.min;
+    if(m.max > l->max)
+        l->max = m.max;
+    l->total += m.total;
+    l->count += m.count;
+    for(unsigned int i = 0; i < BUCKETS; i++)
+        l->histogram[i] += m.histogram[i];
+}
+
+void reset(Latency * l)
+{
+    l->count = l->min = l->max = l->total = 0;
+    for(unsigned int i = 0; i < BUCKETS; i++)
+        l->histogram[i] = 0;
+}
+
+void release(void * ptr)
+{
+    if(Traits<System>::multiheap)
+        Heap::typed_free(ptr);
+    else
+        Heap::untyped_free(heap, ptr);
+}
+
+// Leaves the blocks still live after the last round behind, so they can be freed by another CPU
+int replay(unsigned int r)
+{
+    Replayer * p = &replayers[r];
+
+    for(unsigned int k = 0; k < ROUNDS; k++) {
+        for(unsigned int i = 0; i < OPERATIONS; i++) {
+            Operation * op = &p->trace[i];
+            if(op->bytes) {
+                Time_Stamp t0 = TSC::time_stamp();
+                p->blocks[op->slot] = heap->alloc(op->bytes);
+                record(&p->alloc, TSC::time_stamp() - t0);
+            } else if(p->blocks[op->slot]) {
+                Time_Stamp t0 = TSC::time_stamp();
+                release(p->blocks[op->slot]);
+                record(&p->free, TSC::time_stamp() - t0);
+                p->blocks[op->slot] = 0;
+            }
+        }
+
+        // Drain what is still live, so every round starts from the same state
+        if(k < ROUNDS - 1)
+            for(unsigned int i = 0; i < SLOTS; i++)
+                if(p->blocks[i]) {
+                    release(p->blocks[i]);
+                    p->blocks[i] = 0;
+                }
+    }
+
+    return 0;
+}
+
+void drain(unsigned int r)
+{
+    Replayer * p = &replayers[r];
+    for(unsigned int i = 0; i < SLOTS; i++)
+        if(p->blocks[i]) {
+            Time_Stamp t0 = TSC::time_stamp();
+            release(p->blocks[i]);
+            record(&p->free, TSC::time_stamp() - t0);
+            p->blocks[i] = 0;
+        }
+}
+
+void print(const char * name, const Latency & l)
+{
+    cout << name << ": count=" << l.count << ",min=" << l.min << ",max=" << l.max
+         << ",avg=" << (l.count ? l.total / l.count : 0) << endl;
+    for(unsigned int i = 0; i < BUCKETS; i++)
+        if(l.histogram[i])
+            cout << "  [" << (i ? 1UL << i : 0) << ", " << (2UL << i) << "): " << l.histogram[i] << endl;
+}
+
+int main()
+{
+    cout << "Heap trace-replay benchmark (" << CPUS << " CPUs, " << (Traits<System>::multiheap ? "typed" : "untyped")
+         << " heap, " << (Traits<Heaps>::cached ? "with" : "without") << " magazines)" << endl;
+
+    Heap h(pool, sizeof(pool));
+    heap = &h;
+
+    for(unsigned int i = 0; i < CPUS; i++)
+        generate(replayers[i].trace);
+
+    cout << "Latencies in TSC ticks at " << TSC::frequency() << " Hz:" << endl;
+
+    // main alone
+    replay(0);
+    drain(0);
+    print("alloc", replayers[0].alloc);
+    print("free", replayers[0].free);
+
+    if(CPUS > 1) {
+        // One thread per CPU at once; main frees what they leave live, so those blocks go back to other CPUs
+        reset(&replayers[0].alloc);
+        reset(&replayers[0].free);
+
+        Thread * threads[CPUS];
+        for(unsigned int i = 0; i < CPUS; i++)
+            threads[i] = new Thread(&replay, i);
+        for(unsigned int i = 0; i < CPUS; i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+        for(unsigned int i = 0; i < CPUS; i++)
+            drain(i);
+
+        Latency allocs, frees;
+        reset(&allocs);
+        reset(&frees);
+        for(unsigned int i = 0; i < CPUS; i++) {
+            merge(&allocs, replayers[i].alloc);
+            merge(&frees, replayers[i].free);
+        }
+
+        cout << "Concurrently on " << CPUS << " CPUs:" << endl;
+        print("alloc", allocs);
+        print("free", frees);
+    }
+
+    heap->report(cout);
+
+    Heap::Statistics s = heap->statistics();
+    if(s.in_use || s.failures || (s.allocations != s.frees))
+        cout << "Heap still has " << s.in_use << " bytes in use after draining the traces!" << endl;
+
+    cout << "I'm done, bye!" << endl;
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef __traits_h
+#define __traits_h
+
+#include <system/config.h>
+
+__BEGIN_SYS
+
+// Build
+template<> struct Traits<Build>: public Traits_Tokens
+{
+    // Basic configuration
+    static const unsigned int SMOD = LIBRARY;
+    static const unsigned int ARCHITECTURE = RV64;
+    static const unsigned int MACHINE = RISCV;
+    static const unsigned int MODEL = SiFive_U;
+    static const unsigned int CPUS = 4;
+    static const unsigned int NETWORKING = STANDALONE;
+    static const unsigned int EXPECTED_SIMULATION_TIME = 60; // s (0 => not simulated)
+
+    // Default flags
+    static const bool enabled = true;
+    static const bool monitored = true;
+    static const bool debugged = true;
+    static const bool hysterically_debugged = false;
+};
+
+
+// Utilities
+template<> struct Traits<Debug>: public Traits<Build>
+{
+    static const bool error   = true;
+    static const bool warning = true;
+    static const bool info    = false;
+    static const bool trace   = false;
+};
+
+template<> struct Traits<Lists>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+};
+
+template<> struct Traits<Spin>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+
+    // Core_Spin (kernel locks): CAS (test-and-test-and-set), TICKET (FIFO) or MCS (FIFO, local spinning)
+    enum {CAS, TICKET, MCS};
+    static const unsigned int algorithm = (CPUS > 1) ? TICKET : CAS;
+
+    // Contention profiling of Core_Spin (see Lock_Profiler::report())
+    static const bool profiled = false;
+    static const bool call_sites = false;         // also attribute statistics to the caller
+    static const unsigned int PROFILED_LOCKS = 64;
+};
+
+template<> struct Traits<Heaps>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+
+    // Allocation engine: FIRST_FIT (address-ordered free list) or TLSF (two-level segregated fit, O(1))
+    enum {FIRST_FIT, TLSF};
+    static const unsigned int allocator = TLSF;
+
+    // Per-CPU magazines of small blocks in front of the engine
+    static const bool cached = (CPUS > 1);
+    static const unsigned int MAGAZINE_SIZE = 16;
+
+    // Per-type object caches (slabs) for kernel objects allocated with new (SYSTEM)
+    static const bool object_caches = true;
+    static const unsigned int SLAB_OBJECTS = 16;
+
+    // Usage statistics (see Heap::report())
+    static const bool statistics = true;
+    static const bool call_sites = true;          // also attribute allocations to the caller
+    static const unsigned int PROFILED_SITES = 32;
+};
+
+template<> struct Traits<Observers>: public Traits<Build>
+{
+    // Some observed objects are created before initializing the Display
+    // Enabling debug may cause trouble in some Machines
+    static const bool debugged = false;
+};
+
+
+// System Parts (mostly to fine control debugging)
+template<> struct Traits<Boot>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Setup>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Init>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Framework>: public Traits<Build>
+{
+};
+
+template<> struct Traits<Aspect>: public Traits<Build>
+{
+    static const bool debugged = hysterically_debugged;
+};
+
+
+__END_SYS
+
+// Mediators
+#include __ARCHITECTURE_TRAITS_H
+#include __MACHINE_TRAITS_H
+
+__BEGIN_SYS
+
+
+// API Components
+template<> struct Traits<Application>: public Traits<Build>
+{
+    static const unsigned int STACK_SIZE = Traits<Machine>::STACK_SIZE;
+    static const unsigned int HEAP_SIZE = Traits<Machine>::HEAP_SIZE;
+    static const unsigned int MAX_THREADS = Traits<Machine>::MAX_THREADS;
+};
+
+template<> struct Traits<System>: public Traits<Build>
+{
+    static const bool multithread = (Traits<Application>::MAX_THREADS > 1);
+    static const bool multiheap = Traits<Scratchpad>::enabled || Traits<MMU>::colorful;
+
+    static const unsigned long LIFE_SPAN = 1 * YEAR; // s
+    static const unsigned int DUTY_CYCLE = 1000000; // ppm
+
+    static const bool reboot = true;
+
+    static const unsigned int STACK_SIZE = Traits<Machine>::STACK_SIZE;
+    static const unsigned int HEAP_SIZE = (Traits<Application>::MAX_THREADS + 1) * Traits<Application>::STACK_SIZE;
+};
+
+template<> struct Traits<Thread>: public Traits<Build>
+{
+    static const bool enabled = Traits<System>::multithread;
+    static const bool trace_idle = hysterically_debugged;
+    static const bool simulate_capacity = false;
+    static const int priority_inversion_protocol = NONE;
+
+    // Paint stacks when threads are created, so stack_high_water() can tell how deep they have ever gone
+    static const bool stack_painting = true;
+
+    // Invalidate the page right under each stack, so overflows fault (needs system memory mapped by page tables)
+    static const bool stack_guard = false;
+
+    typedef IF<(CPUS > 1), PLLF, LLF>::Result Criterion;
+    static const unsigned int QUANTUM = 10000; // us
+};
+
+template<> struct Traits<Scheduler<Thread>>: public Traits<Build>
+{
+    static const bool debugged = Traits<Thread>::trace_idle || hysterically_debugged;
+};
+
+template<> struct Traits<Synchronizer>: public Traits<Build>
+{
+    static const bool enabled = Traits<System>::multithread;
+
+    // Adaptive Mutex: spin while the owner is running on another CPU before blocking
+    static const bool adaptive = (CPUS > 1);
+    static const unsigned int MAX_SPINS = 1000;   // upper bound for the self-tuned spin phase
+
+    // RW_Lock: blocked writers go ahead of readers arriving later
+    static const bool writer_preference = true;
+
+    // Contention profiling of synchronizers (see Lock_Profiler::report())
+    static const bool profiled = false;
+};
+
+template<> struct Traits<Alarm>: public Traits<Build>
+{
+    static const bool visible = hysterically_debugged;
+};
+
+template<> struct Traits<Address_Space>: public Traits<Build> {};
+
+template<> struct Traits<Segment>: public Traits<Build> {};
+
+__END_SYS
+
+#endif
@@ -0,0 +1,6 @@
+// EPOS Heap Trace-Replay Benchmark on a Typed Heap
+
+// The same benchmark as tests/heap_test, built with Traits<System>::multiheap, so every block carries its heap's
+// address and is freed through Heap::typed_free()
+
+#include "../heap_test/heap_test.cc"
@@ -0,0 +1,98 @@
+// EPOS Latch Synchronizer Test Program
+
+#include <synchronizer.h>
+#include <process.h>
+
+using namespace EPOS;
+
+const int waiters = 4;
+
+OStream cout;
+
+Latch * latch;
+volatile int released;
+
+int waiter(int n)
+{
+    latch->wait();
+    released++;
+
+    return n;
+}
+
+int main()
+{
+    cout << "Latch test" << endl;
+
+    Thread * threads[waiters];
+    bool failed = false;
+
+    // Counts that cross zero in a single call must release the waiters
+    latch = new Latch(3);
+    released = 0;
+    for(int i = 0; i < waiters; i++)
+        threads[i] = new Thread(&waiter, i);
+    Thread::yield(); // let them all block on the latch
+
+    latch->count_down(0);
+    Thread::yield();
+    if(released) {
+        cout << "count_down(0) released " << released << " waiters early!" << endl;
+        failed = true;
+    }
+
+    latch->count_down(1);
+    Thread::yield();
+    if(released) {
+        cout << "count_down(1) released " << released << " waiters with the count at 2!" << endl;
+        failed = true;
+    }
+
+    latch->count_down(5);
+    for(int i = 0; i < waiters; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    if(released != waiters) {
+        cout << "count_down(5) released " << released << " of " << waiters << " waiters!" << endl;
+        failed = true;
+    }
+    if(!latch->try_wait()) {
+        cout << "try_wait() failed on an open latch!" << endl;
+        failed = true;
+    }
+
+    // An open latch does not block anyone
+    latch->wait();
+    delete latch;
+
+    // Counts that reach exactly zero
+    latch = new Latch(4);
+    released = 0;
+    for(int i = 0; i < waiters; i++)
+        threads[i] = new Thread(&waiter, i);
+    Thread::yield();
+
+    latch->count_down(2);
+    Thread::yield();
+    if(released) {
+        cout << "count_down(2) released " << released << " waiters with the count at 2!" << endl;
+        failed = true;
+    }
+
+    latch->count_down(2);
+    for(int i = 0; i < waiters; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    if(released != waiters) {
+        cout << "count_down(2) released " << released << " of " << waiters << " waiters!" << endl;
+        failed = true;
+    }
+    delete latch;
+
+    cout << (failed ? "Latch test FAILED!" : "Latch test passed.") << endl;
+    cout << "I'm done, bye!" << endl;
+
+    return failed;
+}
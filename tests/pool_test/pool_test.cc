@@ -0,0 +1,199 @@
+// EPOS Block Pool, Memory Pool and Arena Test Program
+
+// Exhausts and refills each kind of pool, checks that Pooled objects cannot be created once their pool is full,
+// and then has one thread per CPU allocate and free blocks of a shared Block_Pool at once, checking that no block
+// is ever handed out twice, that none is lost and that the pool's statistics add up.
+
+#include <utility/ostream.h>
+#include <utility/pool.h>
+#include <utility/arena.h>
+#include <process.h>
+
+using namespace EPOS;
+
+const unsigned int CPUS = Traits<Build>::CPUS;
+const unsigned int BLOCKS = 64;
+const unsigned int HOLD = 24;           // blocks each thread tries to hold at once (more than its share, so pools run dry)
+const unsigned int ROUNDS = 2000;
+
+struct Stamp
+{
+    unsigned int owner;
+    unsigned int round;
+    unsigned int index;
+};
+
+class Message: public Pooled<Message, 8>
+{
+public:
+    Message(int i): _i(i) {}
+
+    int i() const { return _i; }
+
+private:
+    int _i;
+};
+
+OStream cout;
+
+char region[BLOCKS * ((sizeof(Stamp) + Block_Pool::ALIGN - 1) & ~(Block_Pool::ALIGN - 1))];
+Block_Pool * pool;
+unsigned long allocations[CPUS];
+unsigned long failures[CPUS];
+volatile bool failed;
+
+void fail(const char * what)
+{
+    cout << what << endl;
+    failed = true;
+}
+
+// Takes every block of p (which must have all of them free), checks they are distinct and gives them back
+void exhaust(Block_Pool * p, const char * name)
+{
+    void * blocks[BLOCKS];
+    unsigned int n = 0;
+
+    while(n < BLOCKS) {
+        void * b = p->alloc();
+        if(!b)
+            break;
+        if(!p->contains(b))
+            fail("Block out of the pool's region!");
+        for(unsigned int i = 0; i < n; i++)
+            if(blocks[i] == b)
+                fail("Block handed out twice!");
+        blocks[n++] = b;
+    }
+    if((n != p->count()) || !p->empty() || p->alloc()) {
+        cout << name << ": got " << n << " of " << p->count() << " blocks!" << endl;
+        failed = true;
+    }
+
+    for(unsigned int i = 0; i < n; i++)
+        p->free(blocks[i]);
+    if(p->empty())
+        fail("Pool still empty after being refilled!");
+}
+
+int hammer(unsigned int id)
+{
+    Stamp * held[HOLD];
+
+    for(unsigned int r = 0; r < ROUNDS; r++) {
+        unsigned int n = 0;
+        while(n < HOLD) {
+            Stamp * s = reinterpret_cast<Stamp *>(pool->alloc());
+            if(!s) {
+                failures[id]++;
+                break;
+            }
+            s->owner = id;
+            s->round = r;
+            s->index = n;
+            held[n++] = s;
+        }
+        allocations[id] += n;
+
+        Thread::yield();
+
+        for(unsigned int i = 0; i < n; i++) {
+            if((held[i]->owner != id) || (held[i]->round != r) || (held[i]->index != i))
+                fail("Block taken by another thread while held!");
+            pool->free(held[i]);
+        }
+    }
+
+    return 0;
+}
+
+int main()
+{
+    cout << "Pool test (" << CPUS << " CPUs)" << endl;
+
+    // Block pools over a given region and over the heap
+    {
+        Block_Pool p(region, sizeof(Stamp), BLOCKS);
+        exhaust(&p, "Block_Pool");
+        exhaust(&p, "Block_Pool (refilled)");
+    }
+    {
+        Block_Pool p(sizeof(Stamp), BLOCKS);
+        exhaust(&p, "Block_Pool (heap)");
+    }
+
+    // Memory pool
+    {
+        Memory_Pool<Stamp, BLOCKS> p(true);
+        Stamp * objects[BLOCKS];
+        for(unsigned int i = 0; i < BLOCKS; i++)
+            if(!(objects[i] = p.create()))
+                fail("Memory_Pool ran out before its capacity!");
+        if(!p.empty() || p.create())
+            fail("Memory_Pool handed out more objects than its capacity!");
+        for(unsigned int i = 0; i < BLOCKS; i++)
+            p.destroy(objects[i]);
+        Memory_Pool<Stamp, BLOCKS>::Statistics s = p.statistics();
+        if((s.allocations != BLOCKS) || (s.frees != BLOCKS) || (s.failures != 1) || s.in_use || (s.peak != BLOCKS))
+            fail("Memory_Pool statistics are wrong!");
+    }
+
+    // Pooled objects
+    {
+        Message * messages[8];
+        for(unsigned int i = 0; i < 8; i++)
+            if(!(messages[i] = new Message(i)))
+                fail("Pooled ran out before its capacity!");
+        if(new Message(8))
+            fail("Pooled operator new did not return 0 on a full pool!");
+        for(unsigned int i = 0; i < 8; i++) {
+            if(messages[i]->i() != int(i))
+                fail("Pooled object corrupted!");
+            delete messages[i];
+        }
+        Message * m = new Message(9);
+        if(!m)
+            fail("Pooled did not get its objects back!");
+        delete m;
+    }
+
+    // Arena
+    {
+        Arena a(region, sizeof(region));
+        if(!a.create<Stamp>() || a.overflowed())
+            fail("Arena allocation failed!");
+        if(a.alloc(sizeof(region)) || !a.overflowed() || (a.overflows() != 1))
+            fail("Arena did not overflow!");
+        a.reset();
+        if(a.used() || a.overflowed() || !a.alloc(sizeof(region)))
+            fail("Arena reset is wrong!");
+    }
+
+    // All CPUs at once on a shared pool
+    pool = new Block_Pool(sizeof(Stamp), BLOCKS, true);
+    Thread * threads[CPUS];
+    for(unsigned int i = 0; i < CPUS; i++)
+        threads[i] = new Thread(&hammer, i);
+    for(unsigned int i = 0; i < CPUS; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    unsigned long total = 0, missed = 0;
+    for(unsigned int i = 0; i < CPUS; i++) {
+        total += allocations[i];
+        missed += failures[i];
+    }
+    Block_Pool::Statistics s = pool->statistics();
+    cout << "Concurrently on " << CPUS << " CPUs: " << s.allocations << " allocations, " << s.frees << " frees, "
+         << s.failures << " failures, peak of " << s.peak << " blocks" << endl;
+    if((s.allocations != total) || (s.frees != total) || (s.failures != missed) || s.in_use || (s.peak > BLOCKS))
+        fail("Block_Pool statistics do not match the threads' counts!");
+    exhaust(pool, "Block_Pool (after the threads)");
+    delete pool;
+
+    cout << (failed ? "Pool test FAILED!" : "Pool test passed.") << endl;
+    cout << "I'm done, bye!" << endl;
+
+    return failed;
+}